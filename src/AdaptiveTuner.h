@@ -0,0 +1,158 @@
+/*
+  Lattices - A Just-Intonation graphical MTS-ESP Source
+
+  Copyright 2023-2024 Andreya Ek Frisk and Paul Walker.
+
+  This code is released under the MIT licence, but do note that it depends
+  on the JUCE library, see licence for more details.
+
+  Source available at https://github.com/Andreya-Autumn/lattices
+*/
+
+#pragma once
+
+#include <utility>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+
+#include "ScaleModes.h"
+
+//==============================================================================
+// Picks a lattice position for whatever chord is held. A chord is in tune where
+// its notes sit close together on the lattice, so every pair of notes costs the
+// Tenney height of the interval between them, and moving away from where we are
+// costs a little per step so the tuning doesn't wander more than it needs to.
+//
+// The pair costs only depend on the shape, so they're worked out up front. Per
+// search the chord's cost is worked out once for every reference note and shape,
+// after that each position is a lookup. Positions are tried in rings around the
+// current one, stopping when no further ring can win, when the radius runs out,
+// or when the time is up.
+struct AdaptiveTuner
+{
+    static constexpr int numModes{ScaleModes::numSlots};
+    static constexpr int numShapes{ModeTable::maxPhases}; // one per phase of a mode
+
+    // Cost of one step away from the current position. Less than a fifth, so a
+    // better chord is always worth a step.
+    static constexpr float stepCost{0.5f};
+
+    void setMode(int mode, const ModeTable &t)
+    {
+        shapes[mode] = t.period;
+        for (int shape = 0; shape < t.period; ++shape)
+            setShape(mode, shape, t.coOrds[shape]);
+    }
+
+    // c is where each of the 12 degrees sits relative to the reference
+    void setShape(int mode, int shape, const std::pair<int, int> *c)
+    {
+        const float fifth = std::log2(3.0f);
+        const float third = std::log2(5.0f);
+
+        for (int i = 0; i < 12; ++i)
+        {
+            for (int j = 0; j < 12; ++j)
+            {
+                pairCost[mode][shape][i][j] = fifth * std::abs(c[i].first - c[j].first)
+                                            + third * std::abs(c[i].second - c[j].second);
+            }
+        }
+    }
+
+    struct Result
+    {
+        int64_t x{0};
+        int64_t y{0};
+        float cost{0};
+        int tried{0};
+        bool outOfTime{false};
+    };
+
+    // chord is a mask of pitch classes. where(x, y, ref, shape) says which reference
+    // note and shape a position has, outOfTime() is checked before every ring.
+    template <typename Where, typename OutOfTime>
+    Result search(int mode, uint16_t chord, int64_t cx, int64_t cy, int radius, int64_t limit,
+                  Where &&where, OutOfTime &&outOfTime) const
+    {
+        int held[12];
+        int n = 0;
+        for (int pc = 0; pc < 12; ++pc)
+        {
+            if (chord & (1 << pc))
+                held[n++] = pc;
+        }
+
+        float chordCost[numShapes][12];
+        for (int s = 0; s < shapes[mode]; ++s)
+        {
+            const auto &pc = pairCost[mode][s];
+            for (int ref = 0; ref < 12; ++ref)
+            {
+                float sum = 0;
+                for (int a = 0; a < n; ++a)
+                {
+                    int i = (held[a] - ref + 12) % 12;
+                    for (int b = a + 1; b < n; ++b)
+                    {
+                        sum += pc[i][(held[b] - ref + 12) % 12];
+                    }
+                }
+                chordCost[s][ref] = sum;
+            }
+        }
+
+        auto costAt = [&](int64_t x, int64_t y) {
+            int ref, shape;
+            where(x, y, ref, shape);
+            return chordCost[shape][ref];
+        };
+
+        Result best;
+        best.x = cx;
+        best.y = cy;
+        best.cost = costAt(cx, cy);
+        best.tried = 1;
+
+        auto consider = [&](int64_t x, int64_t y, float drift) {
+            if (std::abs(x) > limit || std::abs(y) > limit)
+                return;
+
+            float c = costAt(x, y) + drift;
+            ++best.tried;
+            if (c < best.cost)
+            {
+                best.x = x;
+                best.y = y;
+                best.cost = c;
+            }
+        };
+
+        for (int d = 1; d <= radius; ++d)
+        {
+            float drift = stepCost * d;
+            if (drift >= best.cost)
+                break;
+
+            if (outOfTime())
+            {
+                best.outOfTime = true;
+                break;
+            }
+
+            for (int dx = -d; dx <= d; ++dx)
+            {
+                int dy = d - std::abs(dx);
+                consider(cx + dx, cy + dy, drift);
+                if (dy != 0)
+                    consider(cx + dx, cy - dy, drift);
+            }
+        }
+
+        return best;
+    }
+
+    int shapes[numModes]{};
+    float pairCost[numModes][numShapes][12][12]{};
+};
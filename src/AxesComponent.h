@@ -0,0 +1,91 @@
+/*
+  Lattices - A Just-Intonation graphical MTS-ESP Source
+
+  Copyright 2023-2024 Andreya Ek Frisk and Paul Walker.
+
+  This code is released under the MIT licence, but do note that it depends
+  on the JUCE library, see licence for more details.
+
+  Source available at https://github.com/Andreya-Autumn/lattices
+*/
+
+#pragma once
+
+#include <string>
+
+#include "JIMath.h"
+
+//==============================================================================
+// The extra transposition axes: which prime each one steps by, and how far along
+// it the plane is. MIDI can move them too, so the editor keeps them in sync.
+struct AxesComponent : public juce::Component
+{
+    static constexpr int numAxes{3};
+
+    AxesComponent(const int *primes, const int *steps)
+    {
+        for (int a = 0; a < numAxes; ++a)
+        {
+            auto &box = primeBox[a];
+            for (int p = 3; p < JIMath::limit; ++p)
+            {
+                // The prime brought into the octave above 1/1, like the axis steps
+                int den = 1;
+                while (den * 2 < JIMath::primes[p])
+                    den *= 2;
+                box.addItem(std::to_string(JIMath::primes[p]) + "/" + std::to_string(den), p);
+            }
+            box.setSelectedId(primes[a], juce::dontSendNotification);
+            box.onChange = [this]{ primesChanged = true; };
+            addAndMakeVisible(box);
+
+            auto &s = stepSlider[a];
+            s.setSliderStyle(juce::Slider::IncDecButtons);
+            s.setTextBoxStyle(juce::Slider::TextBoxLeft, false, 40, 25);
+            s.setRange(-12, 12, 1);
+            s.setValue(steps[a], juce::dontSendNotification);
+            s.onValueChange = [this]{ stepsChanged = true; };
+            addAndMakeVisible(s);
+        }
+    }
+
+    void resized() override
+    {
+        for (int a = 0; a < numAxes; ++a)
+        {
+            primeBox[a].setBounds(5, 5 + 30 * a, 80, 25);
+            stepSlider[a].setBounds(91, 5 + 30 * a, 120, 25);
+        }
+    }
+
+    void paint(juce::Graphics &g) override
+    {
+        g.setColour(findColour(juce::TextEditor::backgroundColourId));
+        g.fillRect(this->getLocalBounds());
+        g.setColour(juce::Colours::lightgrey);
+        g.drawRect(this->getLocalBounds());
+    }
+
+    int whichPrime(int a)
+    {
+        return primeBox[a].getSelectedId();
+    }
+
+    int whatSteps(int a)
+    {
+        return static_cast<int>(stepSlider[a].getValue());
+    }
+
+    void showSteps(const int *steps)
+    {
+        for (int a = 0; a < numAxes; ++a)
+            stepSlider[a].setValue(steps[a], juce::dontSendNotification);
+    }
+
+    bool primesChanged = false;
+    bool stepsChanged = false;
+
+private:
+    juce::ComboBox primeBox[numAxes];
+    juce::Slider stepSlider[numAxes];
+};
@@ -15,6 +15,7 @@
 #include <utility>
 #include <string>
 #include <cmath>
+#include <cstdint>
 
 struct JIMath
 {
@@ -29,6 +30,18 @@ struct JIMath
     typedef int monzo[limit];
 
     static constexpr int primes[limit] = {2, 3, 5, 7, 11, 13, 17, 19, 23};
+    static constexpr double log2Primes[16] =
+    {
+        1.0,
+        1.5849625007211562,
+        2.321928094887362,
+        2.807354922057604,
+        3.4594316186372973,
+        3.700439718141092,
+        4.087462841250339,
+        4.247927513443585,
+        4.523561956057013
+    };  // padded out to match Exponents
     static constexpr std::pair<uint64_t, uint64_t> Commas[limit] = 
     {
         {531441, 524288},   // 3
@@ -55,56 +68,54 @@ struct JIMath
         twentythree
     };
     
-    double comma(Comma_t c, bool major = true)
+    // log2(3) and log2(5) split three ways, the first two short enough that any
+    // coordinate up to maxExactSteps times them is exact. Far out positions then
+    // keep every bit of their fraction of an octave, which one double can't do.
+    static constexpr int64_t maxExactSteps{int64_t(1) << 38};
+    static constexpr double log2Split3[3]{6492.0 / 4096, 26.0 / 16777216, 1.350039202129749e-08};
+    static constexpr double log2Split5[3]{9511.0 / 4096, -1567.0 / 16777216, 1.0990725384979695e-08};
+    
+    // log2(3^x 5^y / 2^octaves). The octaves come off the exact part first, so the
+    // result is as good at a billion fifths out as it is at one.
+    static double log2Position(int64_t x, int64_t y, int64_t octaves)
+    {
+        double whole = (double)x * log2Split3[0] + (double)y * log2Split5[0] - (double)octaves;
+        double mid = (double)x * log2Split3[1] + (double)y * log2Split5[1];
+        double lo = (double)x * log2Split3[2] + (double)y * log2Split5[2];
+        return whole + mid + lo;
+    }
+    
+    // Comma_t is already the index into Commas
+    static constexpr double comma(Comma_t c, bool major = true)
+    {
+        const auto &[A, B] = Commas[c];
+        return (major) ? (double)A/B : (double)B/A;
+    }
+    
+    // p^e as a double. Exact while p^e fits in the mantissa, rounded once per 53 bits beyond that
+    static constexpr double power(uint64_t p, int e)
     {
-        uint64_t A = 1;
-        uint64_t B = 1;
+        int n = (e < 0) ? -e : e;
+        double res = 1.0;
+        uint64_t acc = 1;
         
-        switch (c)
+        for (int i = 0; i < n; ++i)
         {
-            case pyth:
-                A = Commas[0].first;
-                B = Commas[0].second;
-                break;
-            case syntonic:
-                A = Commas[1].first;
-                B = Commas[1].second;
-                break;
-            case diesis:
-                A = Commas[2].first;
-                B = Commas[2].second;
-                break;
-            case seven:
-                A = Commas[3].first;
-                B = Commas[3].second;
-                break;
-            case eleven:
-                A = Commas[4].first;
-                B = Commas[4].second;
-                break;
-            case thirteen:
-                A = Commas[5].first;
-                B = Commas[5].second;
-                break;
-            case seventeen:
-                A = Commas[6].first;
-                B = Commas[6].second;
-                break;
-            case nineteen:
-                A = Commas[7].first;
-                B = Commas[7].second;
-                break;
-            case twentythree:
-                A = Commas[8].first;
-                B = Commas[8].second;
-                break;
+            if (acc > ((uint64_t)1 << 53) / p)
+            {
+                res *= (double)acc;
+                acc = 1;
+            }
+            acc *= p;
         }
+        res *= (double)acc;
         
-        return (major) ? (double)A/B : (double)B/A;
+        return (e < 0) ? 1.0 / res : res;
     }
     
     // Maybe move these to the tuning library on Tones one day?
-    // 3/2 up by 3/2 is 9/4
+    // 3/2 up by 3/2 is 9/4. Raw multiplies, so they overflow after twenty-odd
+    // fifths: JIRatio is the exact way.
     std::pair<uint64_t, uint64_t> multiplyRatio(uint64_t N1, uint64_t D1, uint64_t N2, uint64_t D2)
     {
         
@@ -132,17 +143,31 @@ struct JIMath
         return {nR, dR};
     }
     
+    // p^e in integers, the caller makes sure it fits
+    static constexpr uint64_t ipow(uint64_t p, int e)
+    {
+        uint64_t r = 1;
+        while (e > 0)
+        {
+            if (e & 1)
+                r *= p;
+            p *= p;
+            e >>= 1;
+        }
+        return r;
+    }
+    
     void monzoToRatio(monzo m, uint64_t &num, uint64_t &denom)
     {
         for (int i = 0; i < limit; ++i)
         {
             if (m[i] > 0)
             {
-                num *= m[i] * primes[i];
+                num *= ipow(primes[i], m[i]);
             }
-            else
+            else if (m[i] < 0)
             {
-                denom *= -1 * m[i] * primes[i];
+                denom *= ipow(primes[i], -m[i]);
             }
         }
     }
@@ -152,7 +177,8 @@ struct JIMath
         auto n = num;
         auto d = denom;
         
-        for (int i = 0; i < limit; ++i)
+        // stop as soon as both sides are used up
+        for (int i = 0; i < limit && (n > 1 || d > 1); ++i)
         {
             while (n % primes[i] == 0)
             {
@@ -229,4 +255,312 @@ private:
     
 };
 
+//==============================================================================
+// A monzo over JIMath::primes, one byte per prime and padded out to 16 so the
+// whole thing is one SIMD register. Adding two is multiplying the ratios.
+struct alignas(16) Exponents
+{
+    static constexpr int lanes{16};
+    int8_t e[lanes]{};
+
+    constexpr Exponents &operator+=(const Exponents &o)
+    {
+        for (int i = 0; i < lanes; ++i)
+            e[i] = static_cast<int8_t>(e[i] + o.e[i]);
+        return *this;
+    }
+
+    constexpr Exponents operator*(int k) const
+    {
+        Exponents r;
+        for (int i = 0; i < lanes; ++i)
+            r.e[i] = static_cast<int8_t>(e[i] * k);
+        return r;
+    }
+
+    constexpr bool operator==(const Exponents &o) const
+    {
+        for (int i = 0; i < lanes; ++i)
+        {
+            if (e[i] != o.e[i])
+                return false;
+        }
+        return true;
+    }
+};
+
+//==============================================================================
+// Every power of every prime that fits in 64 bits, zero past that
+struct PrimePowers
+{
+    constexpr PrimePowers()
+    {
+        for (int i = 0; i < JIMath::limit; ++i)
+        {
+            uint64_t v = 1;
+            uint64_t q = static_cast<uint64_t>(JIMath::primes[i]);
+            for (int e = 0; e < 64 && v != 0; ++e)
+            {
+                p[i][e] = v;
+                v = (v > UINT64_MAX / q) ? 0 : v * q;
+            }
+        }
+    }
+    
+    uint64_t p[JIMath::limit][64]{};
+};
+inline constexpr PrimePowers primePowers{};
+
+//==============================================================================
+// An exact JI ratio, kept as its monzo so multiplying is adding exponents and
+// nothing can overflow the way a uint64_t numerator does after twenty-odd fifths.
+// If an exponent would leave the int8 range the ratio goes invalid instead of
+// wrapping. It only turns into a double, cents or a fraction when asked.
+struct JIRatio
+{
+    Exponents m;
+    bool valid{true};
+    
+    static constexpr JIRatio prime(int i, int e = 1)
+    {
+        JIRatio r;
+        r.m.e[i] = static_cast<int8_t>(e);
+        r.valid = (i >= 0 && i < JIMath::limit && e >= -127 && e <= 127);
+        return r;
+    }
+    
+    // Anything with a factor past 23 isn't representable and comes back invalid
+    static constexpr JIRatio of(uint64_t num, uint64_t den)
+    {
+        JIRatio r;
+        if (num == 0 || den == 0)
+        {
+            r.valid = false;
+            return r;
+        }
+        
+        for (int i = 0; i < JIMath::limit && (num > 1 || den > 1); ++i)
+        {
+            uint64_t p = static_cast<uint64_t>(JIMath::primes[i]);
+            int e = 0;
+            while (num % p == 0)
+            {
+                num /= p;
+                ++e;
+            }
+            while (den % p == 0)
+            {
+                den /= p;
+                --e;
+            }
+            r.m.e[i] = static_cast<int8_t>(e);
+        }
+        r.valid = (num == 1 && den == 1);
+        return r;
+    }
+    
+    constexpr JIRatio operator*(const JIRatio &o) const
+    {
+        return combine(o, 1);
+    }
+    
+    constexpr JIRatio operator/(const JIRatio &o) const
+    {
+        return combine(o, -1);
+    }
+    
+    constexpr JIRatio pow(int k) const
+    {
+        int e[Exponents::lanes]{};
+        for (int i = 0; i < Exponents::lanes; ++i)
+            e[i] = m.e[i] * k;
+        
+        return narrow(e, valid);
+    }
+    
+    constexpr bool operator==(const JIRatio &o) const
+    {
+        return valid == o.valid && m == o.m;
+    }
+    
+    // log2 of everything but the twos, then the twos are just an integer
+    constexpr double log2() const
+    {
+        double l = 0;
+        for (int i = 1; i < JIMath::limit; ++i)
+            l += m.e[i] * JIMath::log2Primes[i];
+        return l + m.e[0];
+    }
+    
+    double toDouble() const
+    {
+        return std::exp2(log2());
+    }
+    
+    double cents() const
+    {
+        return 1200.0 * log2();
+    }
+    
+    // Into [1, 2)
+    constexpr JIRatio octaveReduced() const
+    {
+        double l = log2();
+        int k = static_cast<int>(l);
+        if (k > l)
+            --k;
+        
+        JIRatio r = *this;
+        int e = m.e[0] - k;
+        r.valid = valid && e >= -127 && e <= 127;
+        r.m.e[0] = static_cast<int8_t>(e);
+        return r;
+    }
+    
+    // Only if both sides fit in 64 bits
+    constexpr bool toFraction(uint64_t &num, uint64_t &den) const
+    {
+        if (!valid)
+            return false;
+        
+        // Each side's size straight from the log tables, so the multiplies need no checks
+        double up = 0, down = 0;
+        for (int i = 0; i < JIMath::limit; ++i)
+        {
+            double l = m.e[i] * JIMath::log2Primes[i];
+            (l > 0 ? up : down) += l;
+        }
+        if (up >= 63.99 || -down >= 63.99)
+            return false;
+        
+        num = 1;
+        den = 1;
+        for (int i = 0; i < JIMath::limit; ++i)
+        {
+            int e = m.e[i];
+            if (e > 0)
+                num *= primePowers.p[i][e];
+            else if (e < 0)
+                den *= primePowers.p[i][-e];
+        }
+        return true;
+    }
+    
+private:
+    // A whole-lane add. A lane overflowed if the sum's sign differs from both
+    // sides', or it landed on -128, which can't be negated. Either sets the
+    // sign bit of one OR across the lanes, no branch per lane.
+    constexpr JIRatio combine(const JIRatio &o, int sign) const
+    {
+        JIRatio r;
+        int over = 0;
+        for (int i = 0; i < Exponents::lanes; ++i)
+        {
+            auto a = m.e[i];
+            auto b = static_cast<int8_t>(sign * o.m.e[i]);
+            auto s = static_cast<int8_t>(static_cast<uint8_t>(a) + static_cast<uint8_t>(b));
+            over |= ((a ^ s) & (b ^ s)) | -static_cast<int>(s == -128);
+            r.m.e[i] = s;
+        }
+        r.valid = valid && o.valid && over >= 0;
+        return r;
+    }
+    
+    // Separate passes so each one is a straight line of SIMD
+    static constexpr JIRatio narrow(const int *e, bool ok)
+    {
+        bool fits = true;
+        for (int i = 0; i < Exponents::lanes; ++i)
+            fits &= (e[i] >= -127) & (e[i] <= 127);
+        
+        JIRatio r;
+        for (int i = 0; i < Exponents::lanes; ++i)
+            r.m.e[i] = static_cast<int8_t>(e[i]);
+        r.valid = ok && fits;
+        return r;
+    }
+};
+
+// How many commas a lattice position is away from the note of the same name in the
+// 3x4 block around the origin. Four fifths down a third is a syntonic comma (81/80),
+// three thirds is a diesis (125/128), and between them they cover every way of getting
+// back to the same note, so any position is one of the 12 in the block plus a whole
+// number of each. Kept up to date as the lattice moves, however far it jumps.
+struct CommaDrift
+{
+    // where we are inside the block, x in -1..2, y in -1..1
+    int64_t blockX{0}, blockY{0};
+    int64_t syntonic{0}, diesis{0};
+    
+    void reset()
+    {
+        blockX = blockY = syntonic = diesis = 0;
+    }
+    
+    void move(int64_t dx, int64_t dy)
+    {
+        blockX += dx;
+        blockY += dy;
+        
+        // (4, -1) is a syntonic comma, so four fifths along is one more comma and a third up
+        int64_t s = floorDiv(blockX + 1, 4);
+        blockX -= 4 * s;
+        blockY += s;
+        syntonic += s;
+        
+        int64_t d = floorDiv(blockY + 1, 3);
+        blockY -= 3 * d;
+        diesis += d;
+    }
+    
+    int64_t x() const { return blockX + 4 * syntonic; }
+    int64_t y() const { return blockY - syntonic + 3 * diesis; }
+    
+    int64_t count(JIMath::Comma_t c) const
+    {
+        switch (c)
+        {
+            case JIMath::syntonic:
+                return syntonic;
+            case JIMath::diesis:
+                return diesis;
+            default:
+                return 0;
+        }
+    }
+    
+    // 81/80 up for every syntonic comma, 125/128 down for every diesis
+    void toMonzo(JIMath::monzo &m) const
+    {
+        for (int i = 0; i < JIMath::limit; ++i)
+            m[i] = 0;
+        
+        m[0] = static_cast<int>(-4 * syntonic - 7 * diesis);
+        m[1] = static_cast<int>(4 * syntonic);
+        m[2] = static_cast<int>(-syntonic + 3 * diesis);
+    }
+    
+    double cents() const
+    {
+        return 1200.0 * (syntonic * std::log2(81.0 / 80.0) + diesis * std::log2(125.0 / 128.0));
+    }
+    
+private:
+    static int64_t floorDiv(int64_t a, int64_t b)
+    {
+        return (a >= 0) ? a / b : -((b - 1 - a) / b);
+    }
+};
+
+// Every comma in the table factors over our primes and is smaller than a semitone
+static_assert([] {
+    for (const auto &[A, B] : JIMath::Commas)
+    {
+        double l = JIRatio::of(A, B).log2();
+        if (!JIRatio::of(A, B).valid || l > 1.0 / 12 || l < -1.0 / 12)
+            return false;
+    }
+    return true;
+}(), "commas are small");
+
 #endif // JI_MTS_SOURCE_JIMATH_H
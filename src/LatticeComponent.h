@@ -12,268 +12,411 @@
 #pragma once
 
 #include "JIMath.h"
+#include "ScaleShape.h"
+#include "SphereAtlas.h"
+#include "LatticeLayout.h"
 #include "LatticesBinary.h"
 #include "LatticesAssets.h"
 
 #include <melatonin_blur/melatonin_blur.h>
 
+//==============================================================================
+// Threads for drawing the background in bands, shared by every open editor
+struct LatticeRenderPool
+{
+    static constexpr int maxThreads{7};
+    static constexpr int minBandHeight{96};
+    
+    juce::ThreadPool pool{juce::ThreadPoolOptions{}
+                              .withThreadName("Lattices render")
+                              .withNumberOfThreads(juce::jlimit(1, maxThreads, juce::SystemStats::getNumCpus() - 1))};
+};
+
 //==============================================================================
 struct LatticeComponent : juce::Component
 {
-    LatticeComponent(std::pair<int, int> *c)
+    LatticeComponent(std::pair<int64_t, int64_t> *c, int n = 12)
+    {
+        update(c, n);
+    }
+    
+    // Works out which nodes changed and repaints just around those. False if
+    // nothing we draw has changed.
+    bool update(std::pair<int64_t, int64_t> *c, int n = 12)
     {
-        for (int i = 0; i < 12; ++i)
+        if (n != numCoO)
+        {
+            // Other colours everywhere, so a new background
+            numCoO = n;
+            fifthSteps = ScaleShape::stepsFor(n, 1.5);
+            thirdSteps = ScaleShape::stepsFor(n, 1.25);
+            std::copy(c, c + n, CoO);
+            markLit();
+            repaint();
+            return true;
+        }
+        
+        bool changed = false;
+        for (int i = 0; i < numCoO; ++i)
+        {
+            if (CoO[i] != c[i])
+                changed = true;
+        }
+        if (!changed)
+            return false;
+        
+        // Bit 0 is lit before, bit 1 lit after, bit 2 already looked at. Nodes
+        // too far off screen have no cell and nothing to repaint.
+        for (int i = 0; i < numCoO; ++i)
         {
-            CoO[i] = c[i];
+            int k = layout.cellOf(c[i].first, c[i].second);
+            if (k >= 0)
+                layout.lit[k] |= 2;
         }
+        for (auto *set : {CoO, c})
+        {
+            for (int i = 0; i < numCoO; ++i)
+            {
+                int k = layout.cellOf(set[i].first, set[i].second);
+                if (k < 0 || (layout.lit[k] & 4))
+                    continue;
+                if (layout.lit[k] == 1 || layout.lit[k] == 2)
+                    repaintCell(k);
+                layout.lit[k] |= 4;
+            }
+        }
+        for (int i = 0; i < numCoO; ++i)
+        {
+            int k = layout.cellOf(CoO[i].first, CoO[i].second);
+            if (k >= 0)
+                layout.lit[k] = 0;
+        }
+        for (int i = 0; i < numCoO; ++i)
+        {
+            int k = layout.cellOf(c[i].first, c[i].second);
+            if (k >= 0)
+                layout.lit[k] = 1;
+        }
+        
+        std::copy(c, c + n, CoO);
+        return true;
+    }
+    
+    void resized() override
+    {
+        layout.build(getWidth(), getHeight(), hDistance, vDistance, hDistance + 3.f, vDistance + 3.f);
+        markLit();
     }
     
-    void update(std::pair<int, int> *c)
+    struct PaintStats
     {
-        for (int i = 0; i < 12; ++i)
+        size_t backgroundBytes{0};
+        int backgroundRenders{0};
+        int bands{0};
+        double backgroundMs{0};
+        int dirtyRects{0};
+        int paints{0};
+        double lastMs{0};
+        double averageMs{0};
+    };
+    const PaintStats &getPaintStats() const { return stats; }
+    
+    void paint(juce::Graphics &g) override
+    {
+        auto paintStart = juce::Time::getMillisecondCounterHiRes();
+        
+        if (background.getWidth() != std::max(getWidth(), 1) || background.getHeight() != std::max(getHeight(), 1)
+            || backgroundScale != numCoO)
+            renderBackground();
+        
+        g.drawImageAt(background, 0, 0, false);
+        
+        // Then the lit ones on top, only those reaching into what's being repainted
+        auto clip = g.getClipBounds().toFloat();
+        int near[ScaleShape::maxSize];
+        int numNear = 0;
+        for (int i = 0; i < numCoO; ++i)
+        {
+            int k = layout.cellOf(CoO[i].first, CoO[i].second);
+            if (k < 0 || !layout.visible[k] || !reach(k).intersects(clip))
+                continue;
+            
+            auto [w, v] = CoO[i];
+            drawEdges(g, k, layout.isLit(w + 1, v), layout.isLit(w, v + 1), layout.isLit(w + 1, v - 1), true);
+            near[numNear++] = k;
+        }
+        for (int i = 0; i < numNear; ++i)
         {
-            CoO[i] = c[i];
+            int k = near[i];
+            drawSphere(g, layout.w[k], layout.v[k], layout.x[k], layout.y[k], true);
         }
+        
+        auto ms = juce::Time::getMillisecondCounterHiRes() - paintStart;
+        ++stats.paints;
+        stats.lastMs = ms;
+        stats.averageMs += (ms - stats.averageMs) / std::min(stats.paints, 64);
     }
     
-    void paint(juce::Graphics &g) override
+    // An image and where it goes
+    struct Stamp
     {
-        float ctrDistance{JIRadius * (5.f / 3.f)};
+        juce::Image image;
+        juce::Rectangle<float> at;
+    };
+    
+    // Every node and edge unlit, blurred. Only depends on the size (the editor's
+    // scale comes through as a new size too) and the colours, so it's drawn again
+    // only when one of those changes.
+    void renderBackground()
+    {
+        auto start = juce::Time::getMillisecondCounterHiRes();
+        int width = std::max(getWidth(), 1);
+        int height = std::max(getHeight(), 1);
         
-        float vDistance = 2.0f * ctrDistance;
-        float hDistance = 2.0f * ctrDistance;
+        // The atlas and the names are message thread only, so everything the
+        // bands copy from them is looked up here first
+        std::vector<int> cells;
+        std::vector<Stamp> stamps;
+        for (int k = 0; k < layout.size(); ++k)
+        {
+            if (!layout.visible[k])
+                continue;
+            
+            cells.push_back(k);
+            stamps.resize(stamps.size() + 2);
+            stampsFor(1.f, layout.w[k], layout.v[k], layout.x[k], layout.y[k], false,
+                      stamps[stamps.size() - 2], stamps.back());
+        }
         
-        auto ctrX = getWidth() / 2;
-        auto ctrH = getHeight() / 2;
-
-        auto nV = std::ceil(getHeight() / vDistance);
-        auto nW = std::ceil(getWidth() / hDistance);
+        // One band here, the rest on the pool
+        int bands = juce::jlimit(1, renderPool->pool.getNumThreads() + 1, height / LatticeRenderPool::minBandHeight);
+        std::vector<juce::Image> results(bands);
+        auto band = [&](int b) {
+            results[b] = renderBand(cells, stamps, width, height * b / bands, height * (b + 1) / bands);
+        };
         
-        juce::Image litSpheres{juce::Image::ARGB, getWidth(), getHeight(), true};
-        juce::Image unlitSpheres{juce::Image::ARGB, getWidth(), getHeight(), true};
-        juce::Image sphereBackgrounds{juce::Image::ARGB, getWidth(), getHeight(), true};
-        juce::Image litLines{juce::Image::ARGB, getWidth(), getHeight(), true};
-        juce::Image unlitLines{juce::Image::ARGB, getWidth(), getHeight(), true};
+        std::atomic<int> remaining{bands - 1};
+        juce::WaitableEvent done;
+        for (int b = 1; b < bands; ++b)
+        {
+            renderPool->pool.addJob([&, b] {
+                band(b);
+                if (--remaining == 0)
+                    done.signal();
+            });
+        }
+        band(0);
+        if (bands > 1)
+            done.wait();
+        
+        background = juce::Image(juce::Image::ARGB, width, height, true);
+        juce::Graphics g(background);
+        for (int b = 0; b < bands; ++b)
+            g.drawImageAt(results[b], 0, height * b / bands, false);
+        
+        backgroundScale = numCoO;
+        ++stats.backgroundRenders;
+        stats.bands = bands;
+        stats.backgroundMs = juce::Time::getMillisecondCounterHiRes() - start;
+        stats.backgroundBytes = (size_t)width * (size_t)height * 4;
+    }
+    
+    // Rows y0 to y1 of the background. Drawn with room above and below for the
+    // blur to reach into, so the bands join up as if it was one image. Runs on
+    // the pool: only reads the layout and copies the stamps.
+    juce::Image renderBand(const std::vector<int> &cells, const std::vector<Stamp> &stamps, int width, int y0, int y1) const
+    {
+        int top = y0 - blurMargin;
+        int h = y1 - y0 + 2 * blurMargin;
+        juce::Rectangle<float> area(0.f, (float)top, (float)width, (float)h);
+        
+        juce::Image unlitSpheres(juce::Image::ARGB, width, h, true, juce::SoftwareImageType());
+        juce::Image unlitLines(juce::Image::ARGB, width, h, true, juce::SoftwareImageType());
         {
-            juce::Graphics lS(litSpheres);
             juce::Graphics uS(unlitSpheres);
-            juce::Graphics sB(sphereBackgrounds);
-            juce::Graphics lL(litLines);
             juce::Graphics uL(unlitLines);
-            for (int v = -nV - 1; v < nV + 1; ++v)
+            uS.setOrigin(0, -top);
+            uL.setOrigin(0, -top);
+            for (size_t i = 0; i < cells.size(); ++i)
             {
-                float off = v * hDistance * 0.5f;
-                float y = -v * vDistance + ctrH;
-                if (y < 0 || y > getHeight())
+                if (!reach(cells[i]).intersects(area))
                     continue;
-
-                for (int w = -nW-1; w < nW + 1; ++w)
-                {
-                    float x = w * hDistance + ctrX + off;
-
-                    if (x < 0 || x > getWidth())
-                        continue;
-
-                    bool sphereLit{false}, horizLit{false}, upLit{false}, downLit{false};
-                    std::pair<int, int> C = {w, v}; // current sphere
-                    for (int i = 0; i < 12; ++i)
-                    {
-                        if (C == CoO[i])
-                        {
-                            sphereLit = true;
-                            break;
-                        }
-                    }
-                    if (sphereLit)
-                    {
-                        std::pair<int, int> H = {w + 1, v}; // next one over
-                        std::pair<int, int> U = {w, v + 1}; // next one up
-                        std::pair<int, int> D = {w + 1, v - 1}; // next one down
-                        for (int i = 0; i < 12; ++i)
-                        {
-                            if (H == CoO[i]) horizLit = true;
-                            if (U == CoO[i]) upLit = true;
-                            if (D == CoO[i]) downLit = true;
-                        }
-                    }
-                    
-                    // Horizontal Line
-                    if (horizLit)
-                    {
-                        lL.setColour(juce::Colours::white.withAlpha(1.f));
-                        juce::Line<float> horiz(x, y, x + hDistance, y);
-                        lL.drawLine(horiz, 3.f);
-                    }
-                    else
-                    {
-                        uL.setColour(juce::Colours::white.withAlpha(.75f));
-                        juce::Line<float> horiz(x, y, x + hDistance, y);
-                        uL.drawLine(horiz, 3.f);
-                    }
-                    
-                    // Upward Line
-                    if (upLit)
-                    {
-                        lL.setColour(juce::Colours::white.withAlpha(1.f));
-                        juce::Line<float> up(x, y, x + (hDistance * .5f), y - vDistance);
-                        float l[2] = {7.f, 3.f};
-                        lL.drawDashedLine(up, l, 2, 3.f, 1);
-                    }
-                    else
-                    {
-                        uL.setColour(juce::Colours::white.withAlpha(.75f));
-                        juce::Line<float> up(x, y, x + (hDistance * .5f), y - vDistance);
-                        float l[2] = {7.f, 3.f};
-                        uL.drawDashedLine(up, l, 2, 3.f, 1);
-                    }
-
-                    // Downward Line
-                    if (downLit)
-                    {
-                        lL.setColour(juce::Colours::white.withAlpha(1.f));
-                        juce::Line<float> down(x, y, x + (hDistance * .5f), y + vDistance);
-                        float l[2] = {2.f, 3.f};
-                        lL.drawDashedLine(down, l, 2, 3.f, 1);
-                    }
-                    else
-                    {
-                        uL.setColour(juce::Colours::white.withAlpha(.75f));
-                        juce::Line<float> down(x, y, x + (hDistance * .5f), y + vDistance);
-                        float l[2] = {2.f, 3.f};
-                        uL.drawDashedLine(down, l, 2, 3.f, 1);
-                    }
-                    
-                    // Sphere Backgrounds
-                    auto ellipseRadius = JIRadius * 1.15;
-                    
-                    auto gradient = juce::ColourGradient{};
-                     // Select gradient colour
-                    if ((w + (v * 4)) % 12 == 0)
-                    {
-                        gradient = juce::ColourGradient(com1, x - ellipseRadius, y,
-                                                        com2, x + ellipseRadius, y, false);
-                    }
-                    else if (v == 0)
-                    {
-                        gradient = juce::ColourGradient(p1, x - ellipseRadius, y,
-                                                        p2, x + ellipseRadius, y, false);
-                    }
-                    else if (v == 1 || v == - 1)
-                    {
-                        gradient = juce::ColourGradient(l1c1, x - ellipseRadius, y,
-                                                        l1c2, x + ellipseRadius, y, false);
-                    }
-                    else if (v == 2 || v == - 2)
-                    {
-                        gradient = juce::ColourGradient(l2c1, x - ellipseRadius, y,
-                                                        l2c2, x + ellipseRadius, y, false);
-                    }
-                    else if (v == 3 || v == - 3)
-                    {
-                        gradient = juce::ColourGradient(l3c1, x - ellipseRadius, y,
-                                                        l3c2, x + ellipseRadius, y, false);
-                    }
-                    else
-                    {
-                        gradient = juce::ColourGradient(l4c1, x - ellipseRadius, y,
-                                                        l4c2, x + ellipseRadius, y, false);
-                    }
-                    
-                    // Names or Ratios?
- //                    auto [n,d] = calculateCell(w, v);
- //                    auto s = std::to_string(n) + "/" + std::to_string(d);
-                    std::string s = jim.nameNoteOnLattice(w,v);
-                    // Spheres
-                    juce::Path e{};
-                    e.addEllipse(x - ellipseRadius, y - JIRadius, 2 * ellipseRadius, 2 * JIRadius);
-                    // And their shadows
-                    juce::Path b{};
-                    b.addEllipse(x - ellipseRadius - 1.5, y - JIRadius - 1.5, 2 * ellipseRadius + 3, 2 * JIRadius + 3);
-                    
-                    
-                    if (sphereLit)
-                    {
-                        whiteShadow.render(lS, e);
-                        blackShadow.render(lS, b);
-                        lS.setColour(juce::Colours::black);
-                        lS.fillPath(b);
-                        gradient.multiplyOpacity(1.f);
-                        lS.setGradientFill(gradient);
-                        lS.fillPath(e);
-                        lS.setColour(juce::Colours::white);
-                        lS.drawEllipse(x - ellipseRadius,y - JIRadius, 2 * ellipseRadius, 2 * JIRadius, 3);
-                        lS.setFont(stoke);
-                        lS.drawFittedText(s, x - ellipseRadius + 3, y - (JIRadius / 3.f) , 2.f * (ellipseRadius - 3), .66667f * JIRadius, juce::Justification::horizontallyCentred, 1, 0.05f);
-                    }
-                    else
-                    {
-                        whiteShadow.render(uS, e);
-                        blackShadow.render(uS, b);
-                        uS.setColour(juce::Colours::black);
-                        uS.fillPath(b);
-                        gradient.multiplyOpacity(.75f);
-                        uS.setGradientFill(gradient);
-                        uS.fillPath(e);
-                        uS.setColour(juce::Colours::white.withAlpha(.75f));
-                        uS.drawEllipse(x - ellipseRadius,y - JIRadius, 2 * ellipseRadius, 2 * JIRadius, 3);
-//                        auto pst = juce::PathStrokeType(3.f);
-//                        uS.strokePath(e, pst);
-                        uS.setFont(stoke);
-                        uS.drawFittedText(s, x - ellipseRadius + 3, y - (JIRadius / 3.f) , 2.f * (ellipseRadius - 3), .66667f * JIRadius, juce::Justification::horizontallyCentred, 1, 0.05f);
-                    }
-                }
+                
+                drawEdges(uL, cells[i], true, true, true, false);
+                uS.drawImage(stamps[2 * i].image, stamps[2 * i].at);
+                uS.drawImage(stamps[2 * i + 1].image, stamps[2 * i + 1].at);
             }
         }
+        
+        juce::Image out(juce::Image::ARGB, width, h, true, juce::SoftwareImageType());
+        juce::Graphics g(out);
+        melatonin::CachedBlur blur{3};
         g.drawImageAt(blur.render(unlitLines), 0, 0, false);
-        g.drawImageAt(litLines, 0, 0, false);
         g.drawImageAt(blur.render(unlitSpheres), 0, 0, false);
-        g.drawImageAt(litSpheres, 0, 0, false);
+        
+        return out.getClippedImage({0, blurMargin, width, y1 - y0});
     }
-
-    std::pair<uint64_t, uint64_t> calculateCell(int fifths, int thirds)
+    
+    // A node's sphere, its shadows and the edges to all six neighbours
+    juce::Rectangle<float> reach(int k) const
     {
-        uint64_t n{1}, d{1};
-
-        while(thirds > 0)
+        juce::Point<float> p{layout.x[k], layout.y[k]};
+        return juce::Rectangle<float>(p, p).expanded(hDistance + 3.f, vDistance + 3.f);
+    }
+    
+    // Lit state for the cells of whatever is in CoO, after a new layout or scale
+    void markLit()
+    {
+        std::fill(layout.lit.begin(), layout.lit.end(), 0);
+        for (int i = 0; i < numCoO; ++i)
         {
-            auto [nn,dd] = jim.multiplyRatio(n, d, 5, 4);
-            n = nn;
-            d = dd;
-            thirds--;
+            int k = layout.cellOf(CoO[i].first, CoO[i].second);
+            if (k >= 0)
+                layout.lit[k] = 1;
         }
-
-        while(thirds < 0)
+    }
+    
+    void repaintCell(int k)
+    {
+        auto r = reach(k).getSmallestIntegerContainer();
+        if (!r.intersects(getLocalBounds()))
+            return;
+        
+        repaint(r);
+        ++stats.dirtyRects;
+    }
+    
+    // The three edges going right from a node
+    void drawEdges(juce::Graphics &g, int k, bool horizLit, bool upLit, bool downLit, bool lit) const
+    {
+        using L = LatticeLayout;
+        float x = layout.x[k];
+        float y = layout.y[k];
+        
+        g.setColour(juce::Colours::white.withAlpha(lit ? 1.f : .75f));
+        
+        // Horizontal Line
+        if (horizLit)
         {
-            auto [nn,dd] = jim.divideRatio(n, d, 5, 4);
-            n = nn;
-            d = dd;
-            thirds++;
+            juce::Line<float> horiz(x, y, layout.endX[L::Right][k], layout.endY[L::Right][k]);
+            g.drawLine(horiz, 3.f);
         }
-
-        while(fifths > 0)
+        
+        // Upward Line
+        if (upLit)
         {
-            auto [nn,dd] = jim.multiplyRatio(n, d, 3, 2);
-            n = nn;
-            d = dd;
-            fifths--;
+            juce::Line<float> up(x, y, layout.endX[L::Up][k], layout.endY[L::Up][k]);
+            float l[2] = {7.f, 3.f};
+            g.drawDashedLine(up, l, 2, 3.f, 1);
         }
-
-        while(fifths < 0)
+        
+        // Downward Line
+        if (downLit)
         {
-            auto [nn,dd] = jim.divideRatio(n, d, 3, 2);
-            n = nn;
-            d = dd;
-            fifths++;
+            juce::Line<float> down(x, y, layout.endX[L::Down][k], layout.endY[L::Down][k]);
+            float l[2] = {2.f, 3.f};
+            g.drawDashedLine(down, l, 2, 3.f, 1);
         }
+    }
+    
+    // Which colours a node gets: the origin's note, then by row
+    int shadeOf(int64_t w, int64_t v) const
+    {
+        if ((w * fifthSteps + v * thirdSteps) % numCoO == 0)
+            return 0;
+        return 1 + (int)std::min<int64_t>(std::abs(v), 4);
+    }
+    
+    // Room for a sphere and its shadows, around its centre
+    static juce::Rectangle<float> sphereBounds()
+    {
+        float r = ellipseRadius + 1.5f + 14.f;
+        float h = JIRadius + 1.5f + 14.f;
+        return {-r, -h, 2 * r, 2 * h};
+    }
+    
+    static juce::Rectangle<float> labelBounds()
+    {
+        return {-ellipseRadius + 3, -(JIRadius / 3.f), 2.f * (ellipseRadius - 3), .66667f * JIRadius};
+    }
+    
+    void drawSphere(juce::Graphics &g, int64_t w, int64_t v, float x, float y, bool lit)
+    {
+        Stamp sphere, name;
+        stampsFor(g.getInternalContext().getPhysicalPixelScaleFactor(), w, v, x, y, lit, sphere, name);
+        g.drawImage(sphere.image, sphere.at);
+        g.drawImage(name.image, name.at);
+    }
+    
+    // The sphere and its name out of the atlas
+    void stampsFor(float scale, int64_t w, int64_t v, float x, float y, bool lit, Stamp &sphere, Stamp &name)
+    {
+        auto &sheet = atlas->sheet(JIRadius, scale, sphereBounds(), [this](juce::Graphics &s, int shade, bool l) {
+            renderSphere(s, shade, l);
+        });
+        
+        auto &sprite = sheet.sprites[shadeOf(w, v)][lit ? 1 : 0];
+        sphere = {sprite, SphereAtlas::place(sheet, sprite, x + sheet.bounds.getX(), y + sheet.bounds.getY())};
         
-        auto g = std::gcd(n,d);
-        n = n / g;
-        d = d / g;
+        // Names or Ratios?
+ //        auto [n,d] = calculateCell(w, v);
+ //        auto s = std::to_string(n) + "/" + std::to_string(d);
+        std::string s = jim.nameNoteOnLattice(static_cast<int>(w), static_cast<int>(v));
+        auto lb = labelBounds();
+        auto &label = SphereAtlas::label(sheet, s, lit, lb, [&](juce::Graphics &t) {
+            t.setColour(juce::Colours::white.withAlpha(lit ? 1.f : .75f));
+            t.setFont(stoke);
+            t.drawFittedText(s, 0, 0, (int)lb.getWidth(), (int)lb.getHeight(), juce::Justification::horizontallyCentred, 1, 0.05f);
+        });
+        name = {label, SphereAtlas::place(sheet, label, x + lb.getX(), y + lb.getY())};
+    }
+    
+    // One sphere for the atlas, centred on 0, 0
+    void renderSphere(juce::Graphics &g, int shade, bool lit)
+    {
+        float x = 0, y = 0;
+        
+        // Sphere Backgrounds
+        const juce::Colour from[SphereAtlas::numShades]{com1, p1, l1c1, l2c1, l3c1, l4c1};
+        const juce::Colour to[SphereAtlas::numShades]{com2, p2, l1c2, l2c2, l3c2, l4c2};
+        auto gradient = juce::ColourGradient(from[shade], x - ellipseRadius, y,
+                                             to[shade], x + ellipseRadius, y, false);
+        
+        // Spheres
+        juce::Path e{};
+        e.addEllipse(x - ellipseRadius, y - JIRadius, 2 * ellipseRadius, 2 * JIRadius);
+        // And their shadows
+        juce::Path b{};
+        b.addEllipse(x - ellipseRadius - 1.5, y - JIRadius - 1.5, 2 * ellipseRadius + 3, 2 * JIRadius + 3);
+        
+        whiteShadow.render(g, e);
+        blackShadow.render(g, b);
+        g.setColour(juce::Colours::black);
+        g.fillPath(b);
+        gradient.multiplyOpacity(lit ? 1.f : .75f);
+        g.setGradientFill(gradient);
+        g.fillPath(e);
+        g.setColour(juce::Colours::white.withAlpha(lit ? 1.f : .75f));
+        g.drawEllipse(x - ellipseRadius,y - JIRadius, 2 * ellipseRadius, 2 * JIRadius, 3);
+    }
+
+    std::pair<uint64_t, uint64_t> calculateCell(int fifths, int thirds)
+    {
+        // 3^f 5^t brought into the octave is the same as stacking 3/2s and 5/4s
+        auto r = (JIRatio::prime(1, fifths) * JIRatio::prime(2, thirds)).octaveReduced();
+        
+        uint64_t n{1}, d{1};
+        r.toFraction(n, d);
 
         return {n,d};
     }
 protected:
     static constexpr int JIRadius{26};
+    static constexpr float ellipseRadius{JIRadius * 1.15f};
+    static constexpr int blurMargin{8}; // past what the background's blur reaches
+    static constexpr float ctrDistance{JIRadius * (5.f / 3.f)};
+    static constexpr float vDistance{2.0f * ctrDistance};
+    static constexpr float hDistance{2.0f * ctrDistance};
     JIMath jim;
     
     juce::ReferenceCountedObjectPtr<juce::Typeface> Stoke{ juce::Typeface::createSystemTypefaceFor(LatticesBinary::Stoke_otf, LatticesBinary::Stoke_otfSize)};
@@ -298,25 +441,20 @@ protected:
     juce::Colour l4c1{.5777778f, .97f, .94f, 58.f};
     juce::Colour l4c2{.8666667f, 1.f, .36f, 1.f};
     
-    melatonin::CachedBlur blur{3};
+    juce::Image background;
+    int backgroundScale{0}; // the numCoO it was drawn for
+    PaintStats stats;
+    
     melatonin::DropShadow blackShadow = {juce::Colours::black, 8};
     melatonin::DropShadow whiteShadow = {juce::Colours::antiquewhite, 12};
+    juce::SharedResourcePointer<SphereAtlas> atlas;
+    LatticeLayout layout;
+    juce::SharedResourcePointer<LatticeRenderPool> renderPool;
     
-    std::pair<int, int> CoO[12]
-    {
-        {0,0},
-        {0,0},
-        {0,0},
-        {0,0},
-        {0,0},
-        {0,0},
-        {0,0},
-        {0,0},
-        {0,0},
-        {0,0},
-        {0,0},
-        {0,0},
-    }; // current co-ordinates
+    std::pair<int64_t, int64_t> CoO[ScaleShape::maxSize]{}; // current co-ordinates
+    int numCoO{0};
+    int fifthSteps{7};
+    int thirdSteps{4};
 };
 
 
@@ -0,0 +1,126 @@
+/*
+  Lattices - A Just-Intonation graphical MTS-ESP Source
+
+  Copyright 2023-2024 Andreya Ek Frisk and Paul Walker.
+
+  This code is released under the MIT licence, but do note that it depends
+  on the JUCE library, see licence for more details.
+
+  Source available at https://github.com/Andreya-Autumn/lattices
+*/
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+
+//==============================================================================
+// Where every node near the screen goes, worked out once per size. Rows run
+// along the thirds, each one only as long as it needs to be, so a node's cell
+// is a row lookup and a subtraction. Positions, edge ends and whether a node
+// is lit are kept per cell, one array each.
+struct LatticeLayout
+{
+    enum Edge
+    {
+        Right,
+        Up,
+        Down,
+        numEdges
+    };
+
+    // margin is how far off screen a node can be and still have something show
+    void build(int width, int height, float hDistance, float vDistance, float marginX, float marginY)
+    {
+        hD = hDistance;
+        vD = vDistance;
+        ctrX = width / 2;
+        ctrH = height / 2;
+
+        // y = -v * vD + ctrH, x = w * hD + ctrX + v * hD / 2
+        minV = (int)std::floor((ctrH - height - marginY) / vD);
+        int maxV = (int)std::ceil((ctrH + marginY) / vD);
+
+        rowFirst.clear();
+        rowStart.clear();
+        rowLength.clear();
+        x.clear();
+        y.clear();
+        for (int e = 0; e < numEdges; ++e)
+        {
+            endX[e].clear();
+            endY[e].clear();
+        }
+        w.clear();
+        v.clear();
+        visible.clear();
+
+        for (int row = minV; row <= maxV; ++row)
+        {
+            float off = row * hD * 0.5f;
+            int first = (int)std::floor((-marginX - ctrX - off) / hD);
+            int last = (int)std::ceil((width + marginX - ctrX - off) / hD);
+
+            rowFirst.push_back(first);
+            rowStart.push_back((int)x.size());
+            rowLength.push_back(last - first + 1);
+
+            float cy = -row * vD + ctrH;
+            for (int col = first; col <= last; ++col)
+            {
+                float cx = col * hD + ctrX + off;
+                x.push_back(cx);
+                y.push_back(cy);
+                endX[Right].push_back(cx + hD);
+                endY[Right].push_back(cy);
+                endX[Up].push_back(cx + hD * .5f);
+                endY[Up].push_back(cy - vD);
+                endX[Down].push_back(cx + hD * .5f);
+                endY[Down].push_back(cy + vD);
+                w.push_back(col);
+                v.push_back(row);
+                visible.push_back(cx >= 0 && cx <= width && cy >= 0 && cy <= height);
+            }
+        }
+
+        lit.assign(x.size(), 0);
+    }
+
+    int size() const
+    {
+        return (int)x.size();
+    }
+
+    // -1 if the node is too far off screen to matter
+    int cellOf(int64_t fifths, int64_t thirds) const
+    {
+        int64_t r = thirds - minV;
+        if (r < 0 || r >= (int64_t)rowFirst.size())
+            return -1;
+
+        int64_t i = fifths - rowFirst[r];
+        if (i < 0 || i >= rowLength[r])
+            return -1;
+
+        return rowStart[r] + (int)i;
+    }
+
+    bool isLit(int64_t fifths, int64_t thirds) const
+    {
+        int c = cellOf(fifths, thirds);
+        return c >= 0 && lit[c];
+    }
+
+    std::vector<float> x, y;
+    std::vector<float> endX[numEdges], endY[numEdges];
+    std::vector<int> w, v;
+    std::vector<uint8_t> visible; // centre on screen, so it's drawn
+    std::vector<uint8_t> lit;
+
+private:
+    float hD{1}, vD{1};
+    int ctrX{0}, ctrH{0};
+    int minV{0};
+    std::vector<int> rowFirst, rowStart, rowLength;
+};
@@ -0,0 +1,151 @@
+/*
+  Lattices - A Just-Intonation graphical MTS-ESP Source
+  
+  Copyright 2023-2024 Andreya Ek Frisk and Paul Walker.
+  
+  This code is released under the MIT licence, but do note that it depends
+  on the JUCE library, see licence for more details.
+  
+  Source available at https://github.com/Andreya-Autumn/lattices
+*/
+
+// Times the tuning maths against what it replaced. No JUCE and no MTS-ESP, just
+// the kernels. Exits non-zero if a new kernel disagrees with the old one.
+
+#include <chrono>
+#include <cstdio>
+#include <cmath>
+#include <numeric>
+#include <tuple>
+
+#include "JIMath.h"
+#include "TuningTable.h"
+
+namespace
+{
+// Keeps the optimiser from throwing the work away
+volatile double sink;
+
+// Runs f n times and returns how many runs a second that was
+template <typename F>
+double perSecond(int n, F &&f)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i)
+        f(i);
+    std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+    return n / took.count();
+}
+
+//==============================================================================
+// updateTuning's loop before the layout tables
+void oldKernel(int refNote, double refFreq, const double *ratios, double *freqs)
+{
+    int refMidiNote = refNote + 60;
+    for (int note = 0; note < 128; ++note)
+    {
+        double octaveShift = std::pow(2, std::floor(((double)note - refMidiNote) / 12.0));
+        
+        int degree = (note - refMidiNote) % 12;
+        if (degree < 0) {degree += 12;}
+        
+        freqs[note] = refFreq * ratios[degree] * octaveShift;
+    }
+}
+
+bool tuningTable()
+{
+    const double ratios[12]{1.0, 16.0 / 15, 9.0 / 8, 6.0 / 5, 5.0 / 4, 4.0 / 3,
+                            45.0 / 32, 3.0 / 2, 8.0 / 5, 5.0 / 3, 9.0 / 5, 15.0 / 8};
+    double a[128], b[128];
+    
+    bool same = true;
+    for (int r = 0; r < 12; ++r)
+    {
+        oldKernel(r, 261.6 * ratios[r], ratios, a);
+        TuningTable::build(12, r, 261.6 * ratios[r], ratios, b);
+        for (int n = 0; n < 128; ++n)
+            same = same && std::abs(a[n] - b[n]) <= 1e-12 * a[n];
+    }
+    
+    const int n = 1000000;
+    auto old = perSecond(n, [&](int i) { oldKernel(i % 12, 261.6, ratios, a); sink = a[i & 127]; });
+    auto built = perSecond(n, [&](int i) { TuningTable::build(12, i % 12, 261.6, ratios, b); sink = b[i & 127]; });
+    auto rescaled = perSecond(n, [&](int i) { TuningTable::rescale(b, (i & 1) ? 1.25 : 0.8); sink = b[i & 127]; });
+    
+    std::printf("updateTuning, 128 notes\n");
+    std::printf("  old kernel         %8.2fM updates/s\n", old / 1e6);
+    std::printf("  TuningTable::build %8.2fM updates/s\n", built / 1e6);
+    std::printf("  rescale            %8.2fM updates/s\n", rescaled / 1e6);
+    std::printf("  %s\n\n", same ? "tables match" : "TABLES DIFFER");
+    return same;
+}
+
+//==============================================================================
+// LatticeComponent::calculateCell before JIRatio, a 3/2 or 5/4 at a time
+std::pair<uint64_t, uint64_t> oldCell(JIMath &jim, int fifths, int thirds)
+{
+    uint64_t n{1}, d{1};
+    for (; thirds > 0; --thirds)
+        std::tie(n, d) = jim.multiplyRatio(n, d, 5, 4);
+    for (; thirds < 0; ++thirds)
+        std::tie(n, d) = jim.divideRatio(n, d, 5, 4);
+    for (; fifths > 0; --fifths)
+        std::tie(n, d) = jim.multiplyRatio(n, d, 3, 2);
+    for (; fifths < 0; ++fifths)
+        std::tie(n, d) = jim.divideRatio(n, d, 3, 2);
+    
+    auto g = std::gcd(n, d);
+    return {n / g, d / g};
+}
+
+std::pair<uint64_t, uint64_t> newCell(int fifths, int thirds)
+{
+    uint64_t n{0}, d{0};
+    (JIRatio::prime(1, fifths) * JIRatio::prime(2, thirds)).octaveReduced().toFraction(n, d);
+    return {n, d};
+}
+
+// Every cell with |fifths| <= 8 and |thirds| <= 3, about what's on screen
+bool cellRatios()
+{
+    JIMath jim;
+    constexpr int maxF = 8, maxT = 3, cells = (2 * maxF + 1) * (2 * maxT + 1);
+    
+    bool same = true;
+    for (int f = -maxF; f <= maxF; ++f)
+    {
+        for (int t = -maxT; t <= maxT; ++t)
+            same = same && oldCell(jim, f, t) == newCell(f, t);
+    }
+    
+    auto cell = [](int i, int &f, int &t) {
+        int c = i % cells;
+        f = c / (2 * maxT + 1) - maxF;
+        t = c % (2 * maxT + 1) - maxT;
+    };
+    
+    const int n = 2000000;
+    auto old = perSecond(n, [&](int i) { int f, t; cell(i, f, t); sink = (double)oldCell(jim, f, t).first; });
+    auto ratio = perSecond(n, [&](int i) { int f, t; cell(i, f, t); sink = (double)newCell(f, t).first; });
+    auto product = perSecond(n, [&](int i) {
+        int f, t;
+        cell(i, f, t);
+        sink = (JIRatio::prime(1, f) * JIRatio::prime(2, t)).m.e[2];
+    });
+    
+    std::printf("Lattice cell ratios, |fifths| <= %d, |thirds| <= %d\n", maxF, maxT);
+    std::printf("  multiplyRatio chain %8.2f ns/cell\n", 1e9 / old);
+    std::printf("  JIRatio             %8.2f ns/cell\n", 1e9 / ratio);
+    std::printf("    of which multiply %8.2f ns/cell\n", 1e9 / product);
+    std::printf("  %s\n\n", same ? "ratios match" : "RATIOS DIFFER");
+    return same;
+}
+}
+
+int main()
+{
+    bool ok = tuningTable();
+    ok = cellRatios() && ok;
+    return ok ? 0 : 1;
+}
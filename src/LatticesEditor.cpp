@@ -16,7 +16,7 @@
 LatticesEditor::LatticesEditor(LatticesProcessor &p)
     : juce::AudioProcessorEditor(&p), processor(p)
 {
-    latticeComponent = std::make_unique<LatticeComponent>(p.coOrds);
+    latticeComponent = std::make_unique<LatticeComponent>(p.coOrds, p.activeScaleSize);
     addAndMakeVisible(*latticeComponent);
     latticeComponent->setBufferedToImage(true);
     
@@ -56,11 +56,17 @@ void LatticesEditor::resized()
     
     if (inited)
     {
+        driftLabel->setBounds(10, 10, 300, 20);
+        savedLabel->setBounds(10, 30, 300, 20);
+        if (paintStatsLabel != nullptr)
+            paintStatsLabel->setBounds(10, 50, 600, 20);
         midiButton->setBounds(10, b.getBottom() - 40, 120, 30);
-        midiComponent->setBounds(10, b.getBottom() - 155 - 30 - 10, 120, 155);
+        midiComponent->setBounds(10, b.getBottom() - 205 - 30 - 10, 260, 205);
         
         tuningButton->setBounds(b.getRight() - 216 - 10, b.getBottom() - 40, 216, 30);
-        modeComponent->setBounds(b.getRight() - 216 - 10, b.getBottom() - 180 - 40, 216, 90);
+        modeComponent->setBounds(b.getRight() - 216 - 10, b.getBottom() - 215 - 40, 216, 125);
+        scaleComponent->setBounds(b.getRight() - 216 - 10, b.getBottom() - 285 - 40, 216, 70);
+        axesComponent->setBounds(b.getRight() - 216 - 10, b.getBottom() - 380 - 40, 216, 95);
         originComponent->setBounds(b.getRight() - 216 - 10, b.getBottom() - 95 - 40, 216, 95);
     }
     else
@@ -89,6 +95,8 @@ void LatticesEditor::showTuningMenu()
     bool show = tuningButton->getToggleState();
     originComponent->setVisible(show);
     modeComponent->setVisible(show);
+    scaleComponent->setVisible(show);
+    axesComponent->setVisible(show);
     
     if (show)
     {
@@ -100,6 +108,56 @@ void LatticesEditor::showTuningMenu()
     }
 }
 
+void LatticesEditor::showDrift()
+{
+    juce::int64 s = processor.syntonicDrift;
+    juce::int64 d = processor.diesisDrift;
+    
+    juce::String text;
+    if (s != 0 || d != 0)
+    {
+        text << "Drift: " << s << " syntonic, " << d << " diesis ("
+             << juce::String(processor.driftCents.load(), 1) << " cents)";
+    }
+    driftLabel->setText(text, juce::dontSendNotification);
+}
+
+void LatticesEditor::showSaved()
+{
+    auto saved = processor.getRetunesSaved();
+    if (saved == shownSaved)
+        return;
+    
+    shownSaved = saved;
+    savedLabel->setText("Coalescing saved " + std::to_string(saved) + " retunes", juce::dontSendNotification);
+}
+
+void LatticesEditor::showPaintStats()
+{
+    if (paintStatsLabel == nullptr)
+        return;
+    
+    const auto &s = latticeComponent->getPaintStats();
+    if (s.paints == shownPaints)
+        return;
+    
+    shownPaints = s.paints;
+    juce::String text;
+    text << "Paint " << juce::String(s.lastMs, 2) << " ms (" << juce::String(s.averageMs, 2) << " avg), "
+         << "background " << juce::String(s.backgroundMs, 1) << " ms in " << s.bands << " bands, "
+         << juce::String(s.backgroundBytes / 1048576.0, 1) << " MB, " << s.backgroundRenders << " renders, "
+         << s.dirtyRects << " dirty rects";
+    paintStatsLabel->setText(text, juce::dontSendNotification);
+}
+
+void LatticesEditor::showAxes()
+{
+    int steps[AxesComponent::numAxes];
+    for (int a = 0; a < AxesComponent::numAxes; ++a)
+        steps[a] = processor.extraAxes[a];
+    axesComponent->showSteps(steps);
+}
+
 void LatticesEditor::timerCallback(int timerID) 
 {
     if (timerID == 1)
@@ -116,17 +174,70 @@ void LatticesEditor::timerCallback(int timerID)
     {
         if (processor.changed)
         {
-            latticeComponent->update(processor.coOrds);
-            latticeComponent->repaint();
+            latticeComponent->update(processor.coOrds, processor.activeScaleSize);
+            showDrift();
+            showAxes();
             processor.changed = false;
         }
         
+        showSaved();
+        showPaintStats();
+        
         if (modeComponent->modeChanged)
         {
             processor.modeSwitch(modeComponent->whichMode());
             modeComponent->modeChanged = false;
         }
         
+        if (modeComponent->definitionLoaded)
+        {
+            modeComponent->definitionLoaded = false;
+            
+            if (processor.setCustomMode(modeComponent->definition))
+            {
+                processor.modeSwitch(ScaleModes::custom);
+                modeComponent->setModes(processor.getModeNames(), processor.mode);
+            }
+            else
+            {
+                juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon, "Lattices",
+                                                       "That mode couldn't be loaded. Every degree needs a line, "
+                                                       "and each has to land on its own note, in order of pitch.");
+            }
+        }
+        
+        if (scaleComponent->sizeChanged)
+        {
+            processor.setScaleSize(scaleComponent->whichSize());
+            scaleComponent->sizeChanged = false;
+        }
+        
+        if (scaleComponent->adaptiveChanged)
+        {
+            processor.setAdaptive(scaleComponent->isAdaptive());
+            scaleComponent->adaptiveChanged = false;
+        }
+        
+        if (axesComponent->primesChanged)
+        {
+            for (int a = 0; a < AxesComponent::numAxes; ++a)
+                processor.setExtraPrime(a, axesComponent->whichPrime(a));
+            axesComponent->primesChanged = false;
+        }
+        
+        if (axesComponent->stepsChanged)
+        {
+            for (int a = 0; a < AxesComponent::numAxes; ++a)
+                processor.setExtraAxis(a, axesComponent->whatSteps(a));
+            axesComponent->stepsChanged = false;
+        }
+        
+        if (scaleComponent->recenterChanged)
+        {
+            processor.setAutoRecenter(scaleComponent->recenterCents);
+            scaleComponent->recenterChanged = false;
+        }
+        
         if (midiComponent->settingChanged)
         {
             processor.updateMIDI(midiComponent->data[0],
@@ -135,6 +246,66 @@ void LatticesEditor::timerCallback(int timerID)
                                  midiComponent->data[3],
                                  midiComponent->data[4],
                                  midiComponent->midiChannel);
+            midiComponent->settingChanged = false;
+            midiComponent->showConflict(processor.nrpnConflict);
+        }
+        
+        if (midiComponent->nrpnChanged)
+        {
+            processor.setNRPN(midiComponent->nrpn[0], midiComponent->nrpn[1]);
+            processor.setPadRange(midiComponent->padRange);
+            midiComponent->nrpnChanged = false;
+            midiComponent->showConflict(processor.nrpnConflict);
+        }
+        
+        if (midiComponent->debounceChanged)
+        {
+            processor.setDebounceTime(midiComponent->debounceMs);
+            midiComponent->debounceChanged = false;
+        }
+        
+        if (midiComponent->coalesceChanged)
+        {
+            processor.setCoalesceTime(midiComponent->coalesceMs);
+            midiComponent->coalesceChanged = false;
+        }
+        
+        if (midiComponent->multiChannelChanged)
+        {
+            processor.setMultiChannel(midiComponent->isMultiChannel());
+            midiComponent->multiChannelChanged = false;
+        }
+        
+        if (midiComponent->learnChanged)
+        {
+            processor.learnedMessage = -1;
+            processor.learnAction = midiComponent->learning();
+            midiComponent->learnChanged = false;
+        }
+        
+        if (int m = processor.learnedMessage.exchange(-1); m >= 0)
+        {
+            MIDIBinding b;
+            b.type = m >> 16;
+            b.channel = (m >> 8) & 0xFF;
+            b.number = m & 0x7F;
+            b.action = midiComponent->learning();
+            
+            // Learnt on the channel we listen on, so follow it if that changes
+            if (b.channel == processor.listenOnChannel)
+                b.channel = 0;
+            
+            if (b.action >= 0)
+                processor.addBinding(b);
+            midiComponent->learnFinished();
+        }
+        
+        if (midiComponent->clearRequested)
+        {
+            processor.learnAction = -1;
+            processor.clearBindings();
+            midiComponent->learnFinished();
+            midiComponent->clearRequested = false;
         }
         
         if (originComponent->freqChanged)
@@ -164,8 +335,15 @@ void LatticesEditor::init()
                                                         processor.shiftCCs[2],
                                                         processor.shiftCCs[3],
                                                         processor.shiftCCs[4],
-                                                        processor.listenOnChannel);
+                                                        processor.listenOnChannel,
+                                                        processor.nrpnX,
+                                                        processor.nrpnY,
+                                                        processor.padRange,
+                                                        processor.multiChannel,
+                                                        processor.debounceMs,
+                                                        processor.coalesceMs);
     addAndMakeVisible(*midiComponent);
+    midiComponent->showConflict(processor.nrpnConflict);
     midiComponent->setVisible(false);
     
     tuningButton = std::make_unique<juce::TextButton>("Tuning Settings");
@@ -174,22 +352,58 @@ void LatticesEditor::init()
     tuningButton->setClickingTogglesState(true);
     tuningButton->setToggleState(false, juce::dontSendNotification);
     
-    modeComponent = std::make_unique<ModeComponent>(processor.mode);
+    modeComponent = std::make_unique<ModeComponent>(processor.mode, processor.getModeNames());
     addAndMakeVisible(*modeComponent);
     modeComponent->setVisible(false);
     
+    scaleComponent = std::make_unique<ScaleComponent>(processor.scaleSize, processor.adaptive,
+                                                      processor.recenterCents);
+    addAndMakeVisible(*scaleComponent);
+    scaleComponent->setVisible(false);
+    
+    int primes[AxesComponent::numAxes], steps[AxesComponent::numAxes];
+    for (int a = 0; a < AxesComponent::numAxes; ++a)
+    {
+        primes[a] = processor.extraPrimes[a];
+        steps[a] = processor.extraAxes[a];
+    }
+    axesComponent = std::make_unique<AxesComponent>(primes, steps);
+    addAndMakeVisible(*axesComponent);
+    axesComponent->setVisible(false);
+    
     originComponent = std::make_unique<OriginComponent>(processor.originalRefNote,
                                                         processor.originalRefFreq);
     addAndMakeVisible(*originComponent);
     originComponent->setVisible(false);
     
+    driftLabel = std::make_unique<juce::Label>();
+    driftLabel->setColour(juce::Label::textColourId, juce::Colours::white);
+    addAndMakeVisible(*driftLabel);
+    showDrift();
+    
+    savedLabel = std::make_unique<juce::Label>();
+    savedLabel->setColour(juce::Label::textColourId, juce::Colours::white);
+    addAndMakeVisible(*savedLabel);
+    
+#if JUCE_DEBUG
+    paintStatsLabel = std::make_unique<juce::Label>();
+    paintStatsLabel->setColour(juce::Label::textColourId, juce::Colours::white);
+    addAndMakeVisible(*paintStatsLabel);
+#endif
+    
     auto b = this->getLocalBounds();
     
+    driftLabel->setBounds(10, 10, 300, 20);
+    savedLabel->setBounds(10, 30, 300, 20);
+    if (paintStatsLabel != nullptr)
+        paintStatsLabel->setBounds(10, 50, 600, 20);
     midiButton->setBounds(10, b.getBottom() - 40, 120, 30);
-    midiComponent->setBounds(10, b.getBottom() - 155 - 30 - 10, 120, 155);
+    midiComponent->setBounds(10, b.getBottom() - 205 - 30 - 10, 260, 205);
     
     tuningButton->setBounds(b.getRight() - 216 - 10, b.getBottom() - 40, 216, 30);
-    modeComponent->setBounds(b.getRight() - 216 - 10, b.getBottom() - 180 - 40, 216, 90);
+    modeComponent->setBounds(b.getRight() - 216 - 10, b.getBottom() - 215 - 40, 216, 125);
+    scaleComponent->setBounds(b.getRight() - 216 - 10, b.getBottom() - 285 - 40, 216, 70);
+    axesComponent->setBounds(b.getRight() - 216 - 10, b.getBottom() - 380 - 40, 216, 95);
     originComponent->setBounds(b.getRight() - 216 - 10, b.getBottom() - 95 - 40, 216, 95);
     
     startTimer(0, 5);
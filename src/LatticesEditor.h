@@ -18,6 +18,8 @@
 #include "LatticesProcessor.h"
 #include "LatticeComponent.h"
 #include "ModeComponent.h"
+#include "ScaleComponent.h"
+#include "AxesComponent.h"
 #include "MIDIMenuComponent.h"
 #include "OriginComponent.h"
 #include "MTSWarningComponent.h"
@@ -62,12 +64,27 @@ private:
     std::unique_ptr<juce::TextButton> tuningButton;
     std::unique_ptr<OriginComponent> originComponent;
     std::unique_ptr<ModeComponent> modeComponent;
+    std::unique_ptr<ScaleComponent> scaleComponent;
+    std::unique_ptr<AxesComponent> axesComponent;
+    void showAxes();
     
     std::unique_ptr<juce::TextButton> midiButton;
     std::unique_ptr<MIDIMenuComponent> midiComponent;
     
     std::unique_ptr<MTSWarningComponent> warningComponent;
     
+    std::unique_ptr<juce::Label> driftLabel;
+    void showDrift();
+    
+    std::unique_ptr<juce::Label> savedLabel;
+    uint64_t shownSaved{0};
+    void showSaved();
+    
+    // Debug builds only, what LatticeComponent's paints cost
+    std::unique_ptr<juce::Label> paintStatsLabel;
+    int shownPaints{0};
+    void showPaintStats();
+    
     void init();
     bool inited{false};
     
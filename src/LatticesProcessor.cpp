@@ -12,11 +12,13 @@
 
 #include "LatticesProcessor.h"
 #include "LatticesEditor.h"
+#include "RealtimeAudit.h"
 #include "libMTSMaster.h"
 
 //==============================================================================
 LatticesProcessor::LatticesProcessor()
-    : juce::AudioProcessor(juce::AudioProcessor::BusesProperties().withOutput ("Output", juce::AudioChannelSet::stereo(), true))
+    : juce::AudioProcessor(juce::AudioProcessor::BusesProperties().withOutput ("Output", juce::AudioChannelSet::stereo(), true)),
+      juce::Thread("Lattices Tuning")
 {
     auto distanceReadoutX = juce::AudioParameterIntAttributes{}
         .withStringFromValueFunction([](int value, int maximumStringLength)->juce::String
@@ -142,6 +144,16 @@ LatticesProcessor::LatticesProcessor()
     xParam->addListener(this);
     yParam->addListener(this);
     
+    rebuildDispatch();
+    
+    for (int m = 0; m < ScaleModes::numBuiltins; ++m)
+    {
+        modeTables[m] = builtinModes.tables[m];
+        adaptiveTuner.setMode(m, modeTables[m]);
+    }
+    
+    scale.build(12, modeTables[ScaleModes::Duodene].ratios[0], modeTables[ScaleModes::Duodene].coOrds[0]);
+    
     
     if (MTS_CanRegisterMaster())
     {
@@ -154,20 +166,20 @@ LatticesProcessor::LatticesProcessor()
         startTimer(0, 50);
     }
 
-    if (registeredMTS == true)
-    {
-        mode = Duodene;
-        originalRefFreq = defaultRefFreq;
-        originalRefNote = defaultRefNote;
-        currentRefFreq = originalRefFreq;
-        currentRefNote = originalRefNote;
-        returnToOrigin();
-        startTimer(1, 50);
-    }
+    // Even unregistered, so there's a lattice to move. It just isn't sent anywhere.
+    mode = ScaleModes::Duodene;
+    originalRefFreq = defaultRefFreq;
+    originalRefNote = defaultRefNote;
+    returnToOrigin();
+    
+    startThread(juce::Thread::Priority::high);
+    startTimer(1, 50);
 }
 
 LatticesProcessor::~LatticesProcessor()
 {
+    stopThread(1000);
+    
     xParam->removeListener(this);
     yParam->removeListener(this);
     
@@ -176,7 +188,35 @@ LatticesProcessor::~LatticesProcessor()
 }
 
 //==============================================================================
-void LatticesProcessor::prepareToPlay(double sampleRate, int samplesPerBlock){}
+void LatticesProcessor::prepareToPlay(double sampleRate, int samplesPerBlock)
+{
+    currentSampleRate = sampleRate;
+    debounceSamples = static_cast<int64_t>(sampleRate * debounceMs / 1000.0);
+    
+    sampleClock = 0;
+    for (int ch = 0; ch < 16; ++ch)
+    {
+        for (int t = 0; t < 2; ++t)
+        {
+            for (int i = 0; i < 128; ++i)
+            {
+                held[t][ch][i] = false;
+                releasedAt[t][ch][i] = neverReleased;
+            }
+        }
+        
+        for (auto &v : ccValues[ch])
+            v = 0;
+        nrpnParam[ch] = -1;
+        
+        for (auto &n : sounding[ch])
+            n = false;
+    }
+    
+    for (auto &pc : pitchClassesHeld)
+        pc = 0;
+    chordChanged = false;
+}
 void LatticesProcessor::releaseResources() {}
 bool LatticesProcessor::isBusesLayoutSupported(const BusesLayout& layouts) const {return true;}
 const juce::String LatticesProcessor::getName() const {return JucePlugin_Name;}
@@ -201,7 +241,9 @@ void LatticesProcessor::getStateInformation(juce::MemoryBlock& destData)
 {
     std::unique_ptr<juce::XmlElement> xml(new juce::XmlElement("Lattices"));
     
-    xml->setAttribute("SavedMode", static_cast<int>(mode));
+    xml->setAttribute("SavedMode", mode.load());
+    if (hasCustomMode)
+        xml->setAttribute("custommode", customModeText);
     
     for (int i = 0; i < 5; ++i)
     {
@@ -209,7 +251,16 @@ void LatticesProcessor::getStateInformation(juce::MemoryBlock& destData)
         int v = shiftCCs[i];
         xml->setAttribute(c, v);
     }
-    xml->setAttribute("channel", listenOnChannel);
+    xml->setAttribute("channel", listenOnChannel.load());
+    
+    for (const auto &b : bindings)
+    {
+        auto *e = xml->createNewChildElement("binding");
+        e->setAttribute("type", b.type);
+        e->setAttribute("number", b.number);
+        e->setAttribute("channel", b.channel);
+        e->setAttribute("action", b.action);
+    }
     
     int n = originalRefNote;
     xml->setAttribute("note", n);
@@ -217,12 +268,42 @@ void LatticesProcessor::getStateInformation(juce::MemoryBlock& destData)
     double f = originalRefFreq;
     xml->setAttribute("freq", f);
 
+    xml->setAttribute("viewx", juce::String(viewX.load()));
+    xml->setAttribute("viewy", juce::String(viewY.load()));
+    
     double X = (double)(xParam->get() + maxDistance) / (2*maxDistance);
     double Y = (double)(yParam->get() + maxDistance) / (2*maxDistance);
 
     xml->setAttribute("xp", X);
     xml->setAttribute("yp", Y);
     
+    xml->setAttribute("debounce", debounceMs.load());
+    xml->setAttribute("coalesce", coalesceMs.load());
+    xml->setAttribute("padrange", padRange.load());
+    xml->setAttribute("nrpnx", nrpnX.load());
+    xml->setAttribute("nrpny", nrpnY.load());
+    xml->setAttribute("adaptive", adaptive.load());
+    xml->setAttribute("recenter", recenterCents.load());
+    xml->setAttribute("scalesize", scaleSize.load());
+    for (int a = 0; a < numExtraAxes; ++a)
+    {
+        xml->setAttribute(juce::String("axis_") + std::to_string(a), extraAxes[a].load());
+        xml->setAttribute(juce::String("prime_") + std::to_string(a), extraPrimes[a].load());
+    }
+    
+    // Only for whoever reads the state, locate works these out again from the position
+    xml->setAttribute("syntonicdrift", juce::String(syntonicDrift.load()));
+    xml->setAttribute("diesisdrift", juce::String(diesisDrift.load()));
+    xml->setAttribute("adaptiveradius", adaptiveRadius.load());
+    xml->setAttribute("adaptivebudget", adaptiveBudgetUs.load());
+    
+    xml->setAttribute("multichannel", multiChannel.load());
+    for (int ch = 0; ch < 16; ++ch)
+    {
+        xml->setAttribute(juce::String("cx_") + std::to_string(ch), juce::String(channels[ch].x.load()));
+        xml->setAttribute(juce::String("cy_") + std::to_string(ch), juce::String(channels[ch].y.load()));
+    }
+    
     copyXmlToBinary(*xml, destData);
 }
 
@@ -235,16 +316,12 @@ void LatticesProcessor::setStateInformation(const void* data, int sizeInBytes)
     {
         if (xmlState->hasTagName("Lattices"))
         {
-            int m = xmlState->getIntAttribute("SavedMode");
+            if (xmlState->hasAttribute("custommode"))
+                setCustomMode(xmlState->getStringAttribute("custommode"));
             
-            switch (m)
-            {
-                case Syntonic:
-                    mode = Syntonic;
-                    break;
-                case Duodene:
-                    mode = Duodene;
-            }
+            int m = xmlState->getIntAttribute("SavedMode");
+            if (validMode(m))
+                mode = m;
             
             for (int i = 0; i < 5; ++i)
             {
@@ -255,17 +332,54 @@ void LatticesProcessor::setStateInformation(const void* data, int sizeInBytes)
             
             int mc = xmlState->getIntAttribute("channel");
             listenOnChannel = mc;
+            
+            bindings.clear();
+            for (auto *b : xmlState->getChildWithTagNameIterator("binding"))
+            {
+                bindings.push_back({b->getIntAttribute("type"), b->getIntAttribute("number"),
+                                    b->getIntAttribute("channel"), b->getIntAttribute("action")});
+            }
 
             originalRefNote = xmlState->getIntAttribute("note");
             originalRefFreq = xmlState->getDoubleAttribute("freq");
+            
+            setDebounceTime(xmlState->getDoubleAttribute("debounce", defaultDebounceMs));
+            setCoalesceTime(xmlState->getDoubleAttribute("coalesce", 0.0));
+            setPadRange(xmlState->getIntAttribute("padrange", maxDistance));
+            nrpnX = xmlState->getIntAttribute("nrpnx", -1);
+            nrpnY = xmlState->getIntAttribute("nrpny", -1);
+            adaptive = xmlState->getBoolAttribute("adaptive", false);
+            setAutoRecenter(xmlState->getDoubleAttribute("recenter", 0.0));
+            setScaleSize(xmlState->getIntAttribute("scalesize", 12));
+            for (int a = 0; a < numExtraAxes; ++a)
+            {
+                setExtraPrime(a, xmlState->getIntAttribute(juce::String("prime_") + std::to_string(a), 3 + a));
+                setExtraAxis(a, xmlState->getIntAttribute(juce::String("axis_") + std::to_string(a)));
+            }
+            setAdaptiveSearch(xmlState->getIntAttribute("adaptiveradius", 6),
+                              xmlState->getDoubleAttribute("adaptivebudget", 20.0));
+            
+            for (int ch = 0; ch < 16; ++ch)
+            {
+                channels[ch].x = juce::jlimit<int64_t>(-maxPosition, maxPosition, xmlState->getStringAttribute(juce::String("cx_") + std::to_string(ch)).getLargeIntValue());
+                channels[ch].y = juce::jlimit<int64_t>(-maxPosition, maxPosition, xmlState->getStringAttribute(juce::String("cy_") + std::to_string(ch)).getLargeIntValue());
+                channels[ch].dirty = true;
+            }
+            multiChannel = xmlState->getBoolAttribute("multichannel", false);
+            rebuildDispatch();
 
+            // The view first, the parameters are relative to it
+            viewX = juce::jlimit<int64_t>(-maxView, maxView, xmlState->getStringAttribute("viewx", "0").getLargeIntValue());
+            viewY = juce::jlimit<int64_t>(-maxView, maxView, xmlState->getStringAttribute("viewy", "0").getLargeIntValue());
+            
             float x = xmlState->getDoubleAttribute("xp");
             float y = xmlState->getDoubleAttribute("yp");
 
             xParam->setValueNotifyingHost(x);
             yParam->setValueNotifyingHost(y);
+            hostMovedParams = true;
             
-            locate();
+            locateRequested = true;
             updateHostDisplay(juce::AudioProcessor::ChangeDetails().withNonParameterStateChanged(true));
         }
     }
@@ -279,15 +393,47 @@ void LatticesProcessor::setStateInformation(const void* data, int sizeInBytes)
 
 void LatticesProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
+    // Offline there is no wall clock, every command in the block counts as played at once
+    bool offline = isNonRealtime();
+    RealtimeAudit::ScopedAudioThread audit{!offline};
+    
     buffer.clear();
-    if (!registeredMTS)
-        return;
-    numClients = MTS_GetNumClients();
+    
+    if (dispatchChanged)
+    {
+        juce::SpinLock::ScopedTryLockType lock(dispatchLock);
+        if (lock.isLocked())
+        {
+            dispatch = pendingDispatch;
+            dispatchChanged = false;
+        }
+    }
+    
+    double blockStart = offline ? 0.0 : juce::Time::getMillisecondCounterHiRes();
+    double msPerSample = 1000.0 / currentSampleRate;
     
     for (const auto metadata : midiMessages)
     {
-        respondToMidi(metadata.getMessage());
+        // Nothing we listen to is longer than 3 bytes, and sysex would allocate
+        if (metadata.numBytes > 3)
+            continue;
+        
+        auto pos = metadata.samplePosition;
+        respondToMidi(metadata.getMessage(), pos, offline ? 0.0 : blockStart + pos * msPerSample);
     }
+    
+    if (chordChanged)
+    {
+        chordChanged = false;
+        SlotPin pin{audioSlotPin, customSlot};
+        adapt();
+    }
+    
+    sampleClock += buffer.getNumSamples();
+    ++blocksFinished;
+    
+    if (offline)
+        waitForCommands();
 }
 
 void LatticesProcessor::timerCallback(int timerID)
@@ -305,14 +451,12 @@ void LatticesProcessor::timerCallback(int timerID)
             if (registeredMTS)
             {
                 std::cout << "registered OK" << std::endl;
-                mode = Duodene;
+                mtsReset = true;
+                mode = ScaleModes::Duodene;
                 originalRefFreq = defaultRefFreq;
                 originalRefNote = defaultRefNote;
-                currentRefFreq = originalRefFreq;
-                currentRefNote = originalRefNote;
-                returnToOrigin();
+                resetRequested = true;
                 stopTimer(0);
-                startTimer(1, 50);
             }
             MTStryAgain = false;
         }
@@ -323,45 +467,37 @@ void LatticesProcessor::timerCallback(int timerID)
             MTS_RegisterMaster();
             registeredMTS = true;
             MTSreInit = false;
+            mtsReset = true;
             std::cout << "registered OK" << std::endl;
-            mode = Duodene;
+            mode = ScaleModes::Duodene;
             originalRefFreq = defaultRefFreq;
             originalRefNote = defaultRefNote;
-            currentRefFreq = originalRefFreq;
-            currentRefNote = originalRefNote;
-            returnToOrigin();
+            resetRequested = true;
             stopTimer(0);
-            startTimer(1, 50);
         }
     }
     
+    // Things that used to happen on the audio thread but don't need to
     if (timerID == 1)
     {
-        for (int i = 0; i < 5; ++i)
-        {
-            if (wait[i])
-            {
-                wait[i] = false;
-                hold[i] = false;
-            }
-        }
+        if (registeredMTS)
+            numClients = MTS_GetNumClients();
+        
+        if (hostDisplayChanged.exchange(false))
+            updateHostDisplay(juce::AudioProcessor::ChangeDetails().withNonParameterStateChanged(true));
     }
 }
 
 void LatticesProcessor::modeSwitch(int m)
 {
-    switch (m)
-    {
-        case Syntonic:
-            mode = Syntonic;
-            break;
-        case Duodene:
-            mode = Duodene;
-    }
+    if (!validMode(m))
+        return;
+    
+    mode = m;
     
     updateHostDisplay(juce::AudioProcessor::ChangeDetails().withNonParameterStateChanged(true));
     
-    returnToOrigin();
+    resetRequested = true;
 }
 
 void LatticesProcessor::updateMIDI(int wCC, int eCC, int nCC, int sCC, int hCC, int C)
@@ -375,13 +511,70 @@ void LatticesProcessor::updateMIDI(int wCC, int eCC, int nCC, int sCC, int hCC,
     shiftCCs[4] = hCC;
     listenOnChannel = C;
     
+    rebuildDispatch();
+    
+    updateHostDisplay(juce::AudioProcessor::ChangeDetails().withNonParameterStateChanged(true));
+}
+
+void LatticesProcessor::addBinding(const MIDIBinding &b)
+{
+    // Rebinding a message replaces what it did before
+    bindings.erase(std::remove_if(bindings.begin(), bindings.end(), [&](const MIDIBinding &o) {
+                       return o.type == b.type && o.number == b.number && o.channel == b.channel;
+                   }),
+                   bindings.end());
+    bindings.push_back(b);
+    rebuildDispatch();
+    
     updateHostDisplay(juce::AudioProcessor::ChangeDetails().withNonParameterStateChanged(true));
 }
 
+void LatticesProcessor::clearBindings()
+{
+    bindings.clear();
+    rebuildDispatch();
+    
+    updateHostDisplay(juce::AudioProcessor::ChangeDetails().withNonParameterStateChanged(true));
+}
+
+void LatticesProcessor::rebuildDispatch()
+{
+    // Per-channel lattices listen everywhere
+    int ch = multiChannel ? 0 : listenOnChannel.load();
+    
+    // NRPN takes over CCs 99, 98, 6, 38 and the RPN selects, unless a binding says
+    // otherwise. A CC that's already a direction stays one (East is on 6 by default),
+    // and nrpnConflict says NRPN won't fully work until it's moved.
+    std::vector<MIDIBinding> all;
+    bool conflict = false;
+    if (nrpnX >= 0 || nrpnY >= 0)
+    {
+        const MIDIBinding nrpn[] = {{MIDIBinding::CC, 99, 0, MIDIBinding::NRPNParamMSB},
+                                    {MIDIBinding::CC, 98, 0, MIDIBinding::NRPNParamLSB},
+                                    {MIDIBinding::CC, 6, 0, MIDIBinding::NRPNDataMSB},
+                                    {MIDIBinding::CC, 38, 0, MIDIBinding::NRPNDataLSB},
+                                    {MIDIBinding::CC, 101, 0, MIDIBinding::RPNSelect},
+                                    {MIDIBinding::CC, 100, 0, MIDIBinding::RPNSelect}};
+        for (const auto &b : nrpn)
+        {
+            if (std::find(shiftCCs, shiftCCs + 5, b.number) != shiftCCs + 5)
+                conflict = true;
+            else
+                all.push_back(b);
+        }
+    }
+    nrpnConflict = conflict;
+    all.insert(all.end(), bindings.begin(), bindings.end());
+    
+    juce::SpinLock::ScopedLockType lock(dispatchLock);
+    pendingDispatch.build(shiftCCs, 5, ch, all);
+    dispatchChanged = true;
+}
+
 void LatticesProcessor::updateFreq(double f)
 {
     originalRefFreq = f;
-    returnToOrigin();
+    resetRequested = true;
     
     updateHostDisplay(juce::AudioProcessor::ChangeDetails().withNonParameterStateChanged(true));
 }
@@ -392,198 +585,1094 @@ double LatticesProcessor::updateRoot(int r)
     
     originalRefNote = r;
     originalRefFreq = nf;
-    returnToOrigin();
+    resetRequested = true;
     
     updateHostDisplay(juce::AudioProcessor::ChangeDetails().withNonParameterStateChanged(true));
     
     return nf;
 }
 
+void LatticesProcessor::setDebounceTime(double ms)
+{
+    debounceMs = ms;
+    debounceSamples = static_cast<int64_t>(currentSampleRate * ms / 1000.0);
+    
+    updateHostDisplay(juce::AudioProcessor::ChangeDetails().withNonParameterStateChanged(true));
+}
+
+void LatticesProcessor::setCoalesceTime(double ms)
+{
+    coalesceMs = ms;
+    
+    updateHostDisplay(juce::AudioProcessor::ChangeDetails().withNonParameterStateChanged(true));
+}
+
+void LatticesProcessor::setPadRange(int steps)
+{
+    padRange = juce::jlimit(1, maxDistance, steps);
+    
+    updateHostDisplay(juce::AudioProcessor::ChangeDetails().withNonParameterStateChanged(true));
+}
+
+void LatticesProcessor::setNRPN(int xNumber, int yNumber)
+{
+    nrpnX = (xNumber >= 0 && xNumber < 16384) ? xNumber : -1;
+    nrpnY = (yNumber >= 0 && yNumber < 16384) ? yNumber : -1;
+    rebuildDispatch();
+    
+    updateHostDisplay(juce::AudioProcessor::ChangeDetails().withNonParameterStateChanged(true));
+}
+
+bool LatticesProcessor::setCustomMode(const juce::String &definition)
+{
+    ModeDef d;
+    if (!ModeDef::parse(definition.toStdString(), d))
+        return false;
+    
+    // Into the slot nobody is reading, then make it the live one. Right after a swap
+    // a pass can still be on it, that's a millisecond or so, and a load that comes
+    // while one is somehow stuck there is turned down rather than written under it.
+    int slot = (customSlot == ScaleModes::custom) ? ScaleModes::custom + 1 : ScaleModes::custom;
+    auto pinned = [&] { return audioSlotPin == slot || tuningSlotPin == slot; };
+    for (int i = 0; i < 100 && pinned(); ++i)
+        juce::Thread::sleep(1);
+    if (pinned())
+        return false;
+    
+    if (!ModeTable::compile(d, modeTables[slot]))
+        return false;
+    
+    adaptiveTuner.setMode(slot, modeTables[slot]);
+    customSlot = slot;
+    hasCustomMode = true;
+    customModeText = definition;
+    customModeChanged = true;
+    
+    updateHostDisplay(juce::AudioProcessor::ChangeDetails().withNonParameterStateChanged(true));
+    return true;
+}
+
+bool LatticesProcessor::validMode(int m) const
+{
+    return (m >= 0 && m < ScaleModes::numBuiltins) || (m == ScaleModes::custom && hasCustomMode);
+}
+
+juce::StringArray LatticesProcessor::getModeNames() const
+{
+    juce::StringArray names;
+    for (int m = 0; m < ScaleModes::numBuiltins; ++m)
+        names.add(modeTables[m].name);
+    
+    if (hasCustomMode)
+        names.add(modeTables[customSlot].name[0] != 0 ? modeTables[customSlot].name : "Custom");
+    
+    return names;
+}
+
+int LatticesProcessor::slotOf(int m) const
+{
+    return (m == ScaleModes::custom) ? customSlot.load() : m;
+}
+
+void LatticesProcessor::setScaleSize(int n)
+{
+    if (!ScaleShape::validSize(n))
+        return;
+    
+    scaleSize = n;
+    scaleChanged = true;
+    
+    updateHostDisplay(juce::AudioProcessor::ChangeDetails().withNonParameterStateChanged(true));
+}
+
+void LatticesProcessor::applyScaleSize()
+{
+    int n = scaleSize;
+    if (n == scale.size)
+        return;
+    
+    // Same position, new shape around it
+    const auto &duodene = modeTables[ScaleModes::Duodene];
+    scale.build(n, duodene.ratios[0], duodene.coOrds[0]);
+    activeScaleSize = n;
+    
+    tunedRefNote = -1;
+    tuningCache.clear();
+    updateOffPlane();
+    locateRequested = true;
+}
+
+void LatticesProcessor::setExtraAxis(int axis, int steps)
+{
+    if (axis < 0 || axis >= numExtraAxes)
+        return;
+    
+    extraAxes[axis] = juce::jlimit(-maxExtraDistance, maxExtraDistance, steps);
+    extraAxesChanged = true;
+    locateRequested = true;
+    
+    updateHostDisplay(juce::AudioProcessor::ChangeDetails().withNonParameterStateChanged(true));
+}
+
+void LatticesProcessor::setExtraPrime(int axis, int prime)
+{
+    // 3 and 5 are the plane itself
+    if (axis < 0 || axis >= numExtraAxes || prime < 3 || prime >= JIMath::limit)
+        return;
+    
+    extraPrimes[axis] = prime;
+    extraAxesChanged = true;
+    locateRequested = true;
+    
+    updateHostDisplay(juce::AudioProcessor::ChangeDetails().withNonParameterStateChanged(true));
+}
+
+void LatticesProcessor::setAutoRecenter(double cents)
+{
+    recenterCents = std::max(cents, 0.0);
+    
+    updateHostDisplay(juce::AudioProcessor::ChangeDetails().withNonParameterStateChanged(true));
+}
+
+void LatticesProcessor::setAdaptive(bool a)
+{
+    adaptive = a;
+    
+    updateHostDisplay(juce::AudioProcessor::ChangeDetails().withNonParameterStateChanged(true));
+}
+
+void LatticesProcessor::setAdaptiveSearch(int radius, double budgetMicroseconds)
+{
+    adaptiveRadius = juce::jlimit(0, 2 * maxDistance, radius);
+    adaptiveBudgetUs = std::max(budgetMicroseconds, 0.0);
+    
+    updateHostDisplay(juce::AudioProcessor::ChangeDetails().withNonParameterStateChanged(true));
+}
+
+uint64_t LatticesProcessor::getRetunesSaved() const
+{
+    auto e = navigationEvents.load();
+    auto r = navigationRetunes.load();
+    return (e > r) ? e - r : 0;
+}
+
+void LatticesProcessor::setMultiChannel(bool m)
+{
+    multiChannel = m;
+    rebuildDispatch();
+    
+    updateHostDisplay(juce::AudioProcessor::ChangeDetails().withNonParameterStateChanged(true));
+}
+
 void LatticesProcessor::returnToOrigin()
 {
-    currentRefNote = originalRefNote;
-    currentRefFreq = originalRefFreq;
+    latticeX = 0;
+    latticeY = 0;
+    viewX = 0;
+    viewY = 0;
+    hostMovedParams = false;
     positionX = 0;
     positionY = 0;
     
+    drift.reset();
+    syntonicDrift = 0;
+    diesisDrift = 0;
+    driftCents = 0;
+    
+    for (auto &a : extraAxes)
+        a = 0;
+    extraAxesChanged = false;
+    updateOffPlane();
+    
+    // The reference note is a degree of the scale, so the original one has to be
+    // reduced into it, and transposed along with everything else
+    findReference(0, 0, currentRefNote, currentRefFreq);
+    
+    movingParams = true;
     xParam->beginChangeGesture();
     xParam->setValueNotifyingHost(0.5);
     xParam->endChangeGesture();
     yParam->beginChangeGesture();
     yParam->setValueNotifyingHost(0.5);
     yParam->endChangeGesture();
+    movingParams = false;
             
-    for (int i = 0; i < 12; ++i)
+    findShape(0, 0, ratios, coOrds, slotOf(mode));
+    
+    // A new origin sends every channel home too
+    for (auto &c : channels)
     {
-        ratios[i] = duo12[i];
-        coOrds[i] = duoCo[i];
+        c.x = 0;
+        c.y = 0;
+        c.dirty = true;
     }
     
     updateTuning();
+    
+    // We just tuned for home, no need to do it again for the parameters moving there
+    locateRequested = false;
 }
 
-void LatticesProcessor::respondToMidi(const juce::MidiMessage &m)
+void LatticesProcessor::respondToMidi(const juce::MidiMessage &m, int sampleOffset, double time)
 {
-    if (m.isController() && m.getChannel() == listenOnChannel)
+    auto channel = m.getChannel();
+    auto ch = channel - 1;
+    
+    if (learnAction >= 0 && learn(m))
+        return;
+    
+    int action = MidiDispatch::none;
+    bool press = false;
+    int type = 0; // which held/releasedAt, CC or note
+    int number = 0;
+    
+    if (m.isController())
     {
-        auto num = m.getControllerNumber();
-        auto val = m.getControllerValue();
+        number = m.getControllerNumber();
+        ccValues[ch][number] = static_cast<uint8_t>(m.getControllerValue());
         
-        for (int i = 0; i < 5; ++i)
+        action = dispatch.cc[ch][number];
+        if (MIDIBinding::isAbsolute(action))
         {
-            if (num == shiftCCs[i])
-            {
-                if (val == 127 && hold[i] == false)
-                {
-                    shift(i);
-                    hold[i] = true;
-                }
-                
-                if (val < 127 && hold[i] == true)
-                {
-                    wait[i] = true;
-                }
-            }
+            respondToAbsolute(action, channel, number, time);
+            return;
         }
+        press = m.getControllerValue() == 127;
+    }
+    else if (m.isNoteOn())
+    {
+        type = 1;
+        number = m.getNoteNumber();
+        action = dispatch.note[ch][number];
+        press = true;
+        
+        if (action == MidiDispatch::none)
+            trackNote(channel, m.getNoteNumber(), true, time);
+    }
+    else if (m.isNoteOff())
+    {
+        type = 1;
+        number = m.getNoteNumber();
+        action = dispatch.note[ch][number];
+        
+        if (action == MidiDispatch::none)
+            trackNote(channel, m.getNoteNumber(), false, time);
+    }
+    else if (m.isProgramChange())
+    {
+        // no release to wait for, every program change is a press
+        action = dispatch.program[ch][m.getProgramChangeNumber()];
+        if (action <= Home || MIDIBinding::isAxis(action))
+            pushCommand(pressCommand(action, channel, time));
+        return;
+    }
+    
+    // Absolute actions only make sense on a CC
+    if (action > Home && !MIDIBinding::isAxis(action))
+        return;
+    
+    // A press only counts once the last release is at least debounceSamples old,
+    // anything sooner is treated as the controller bouncing.
+    auto now = sampleClock + sampleOffset;
+    
+    auto &h = held[type][ch][number];
+    auto &r = releasedAt[type][ch][number];
+    
+    if (press && !h)
+    {
+        if (now - r >= debounceSamples)
+            pushCommand(pressCommand(action, channel, time));
+        h = true;
+    }
+    
+    if (!press && h)
+    {
+        h = false;
+        r = now;
     }
 }
 
-void LatticesProcessor::parameterValueChanged(int parameterIndex, float newValue)
+bool LatticesProcessor::learn(const juce::MidiMessage &m)
 {
-    locate();
+    // Absolute actions need a value, so only a CC will do, and the 14-bit
+    // pairs need an MSB with room for its LSB
+    int action = learnAction;
+    int type = -1;
+    int number = 0;
+    
+    if (m.isController())
+    {
+        type = MIDIBinding::CC;
+        number = m.getControllerNumber();
+        if ((action == MIDIBinding::X14 || action == MIDIBinding::Y14) && number >= 32)
+            return false;
+    }
+    else if (m.isNoteOn() && !MIDIBinding::isAbsolute(action))
+    {
+        type = MIDIBinding::Note;
+        number = m.getNoteNumber();
+    }
+    else if (m.isProgramChange() && !MIDIBinding::isAbsolute(action))
+    {
+        type = MIDIBinding::Program;
+        number = m.getProgramChangeNumber();
+    }
+    
+    if (type < 0)
+        return false;
+    
+    learnedMessage = (type << 16) | (m.getChannel() << 8) | number;
+    learnAction = -1;
+    return true;
 }
 
+LatticesProcessor::NavCommand LatticesProcessor::pressCommand(int action, int channel, double time) const
+{
+    if (MIDIBinding::isAxis(action))
+    {
+        int a = action - MIDIBinding::Axis1Up;
+        return {(a % 2 == 0) ? AxisUp : AxisDown, channel, time, blocksFinished.load(), a / 2};
+    }
+    
+    return {action, channel, time, blocksFinished.load()};
+}
 
-
-void LatticesProcessor::shift(int dir)
+void LatticesProcessor::respondToAbsolute(int action, int channel, int number, double time)
 {
-    float X = xParam->get();
-    float Y = yParam->get();
+    // Every absolute action is one command, whatever the distance, so it's one retune
+    auto ch = channel - 1;
+    auto value = ccValues[ch][number];
     
-    switch (dir)
+    auto set = [&](int dir, int position) {
+        pushCommand({dir, channel, time, blocksFinished.load(), position});
+    };
+    
+    switch (action)
     {
-        case West:
-            xParam->beginChangeGesture();
-            X = GNV(X - 1);
-            std::cout << X << std::endl;
-            xParam->setValueNotifyingHost(X);
-            xParam->endChangeGesture();
+        case MIDIBinding::X14:
+        case MIDIBinding::Y14:
+        {
+            // The MSB clears the old LSB and waits, the pair lands when the LSB arrives
+            if (number < 32)
+            {
+                ccValues[ch][number + 32] = 0;
+                break;
+            }
+            int v = (ccValues[ch][number - 32] << 7) | value;
+            set(action == MIDIBinding::X14 ? SetX : SetY, v - 8192);
             break;
-        case East:
-            xParam->beginChangeGesture();
-            X = GNV(X + 1);
-            xParam->setValueNotifyingHost(X);
-            xParam->endChangeGesture();
+        }
+        case MIDIBinding::PadX:
+        case MIDIBinding::PadY:
+        {
+            int range = padRange;
+            int position = (value * 2 * range + 63) / 127 - range;
+            set(action == MIDIBinding::PadX ? SetX : SetY, position);
             break;
-        case North:
-            yParam->beginChangeGesture();
-            Y = GNV(Y + 1);
-            yParam->setValueNotifyingHost(Y);
-            yParam->endChangeGesture();
+        }
+        case MIDIBinding::NRPNParamMSB:
+            nrpnParam[ch] = (value << 7) | (std::max(nrpnParam[ch], 0) & 0x7F);
             break;
-        case South:
-            yParam->beginChangeGesture();
-            Y = GNV(Y - 1);
-            yParam->setValueNotifyingHost(Y);
-            yParam->endChangeGesture();
+        case MIDIBinding::NRPNParamLSB:
+            nrpnParam[ch] = (std::max(nrpnParam[ch], 0) & ~0x7F) | value;
             break;
-        case Home:
-            returnToOrigin();
+        case MIDIBinding::RPNSelect:
+            nrpnParam[ch] = -1;
+            break;
+        case MIDIBinding::NRPNDataMSB:
+            // Same as the 14-bit pairs, an MSB alone would be 64 steps out
+            ccValues[ch][38] = 0;
+            break;
+        case MIDIBinding::NRPNDataLSB:
+        {
+            int v = (ccValues[ch][6] << 7) | value;
+            if (nrpnParam[ch] >= 0 && nrpnParam[ch] == nrpnX)
+                set(SetX, v - 8192);
+            else if (nrpnParam[ch] >= 0 && nrpnParam[ch] == nrpnY)
+                set(SetY, v - 8192);
             break;
+        }
+    }
+}
+
+void LatticesProcessor::trackNote(int channel, int note, bool on, double time)
+{
+    auto listen = listenOnChannel.load();
+    if (listen != 0 && channel != listen)
+        return;
+    
+    auto &s = sounding[channel - 1][note];
+    if (s == on)
+        return;
+    
+    s = on;
+    pitchClassesHeld[note % 12] += on ? 1 : -1;
+    
+    // Only new notes move the lattice, letting go of some shouldn't
+    if (on && adaptive && !chordChanged)
+    {
+        chordChanged = true;
+        chordTime = time;
+    }
+}
+
+void LatticesProcessor::adapt()
+{
+    uint16_t chord = 0;
+    int size = 0;
+    for (int pc = 0; pc < 12; ++pc)
+    {
+        if (pitchClassesHeld[pc] > 0)
+        {
+            chord |= static_cast<uint16_t>(1 << pc);
+            ++size;
+        }
+    }
+    
+    // One note is in tune anywhere
+    if (size < 2 || activeScaleSize != 12)
+        return;
+    
+    int m = slotOf(mode);
+    const auto &table = modeTables[m];
+    int ref = originalRefNote + offPlaneSteps;
+    
+    auto where = [&table, ref](int64_t x, int64_t y, int &note, int &shape) {
+        int64_t nn = ref + 7 * x + 4 * table.adjustY(x, y);
+        note = static_cast<int>(((nn % 12) + 12) % 12);
+        shape = table.phaseOf(x);
     };
     
-    updateHostDisplay(juce::AudioProcessor::ChangeDetails().withNonParameterStateChanged(true));
+    auto start = juce::Time::getHighResolutionTicks();
+    auto budget = static_cast<juce::int64>(adaptiveBudgetUs * 1.0e-6 * juce::Time::getHighResolutionTicksPerSecond());
+    auto outOfTime = [start, budget]() { return juce::Time::getHighResolutionTicks() - start > budget; };
+    
+    int64_t cx = latticeX;
+    int64_t cy = latticeY;
+    auto best = adaptiveTuner.search(m, chord, cx, cy, adaptiveRadius, maxPosition, where, outOfTime);
+    
+    if (best.outOfTime)
+        ++adaptiveTimeouts;
+    
+    // Both halves land in the same group, so it's still the one retune, and it
+    // goes out as soon as this block has been read
+    int channel = listenOnChannel;
+    auto block = blocksFinished.load();
+    if (best.x != cx)
+        pushCommand({SetX, channel, chordTime, block, best.x, true});
+    if (best.y != cy)
+        pushCommand({SetY, channel, chordTime, block, best.y, true});
 }
+
+void LatticesProcessor::parameterValueChanged(int parameterIndex, float newValue)
+{
+    // This can arrive on any thread, including the audio thread, so just flag it
+    locateRequested = true;
     
-void LatticesProcessor::locate()
+    if (!movingParams)
+        hostMovedParams = true;
+}
+
+bool LatticesProcessor::pushCommand(const NavCommand &c)
 {
-    positionX = xParam->get();
-    positionY = yParam->get();
+    // If the queue is ever full the command is dropped rather than blocking the audio thread
+    auto scope = commandFifo.write(1);
+    if (scope.blockSize1 + scope.blockSize2 == 0)
+        return false;
     
-    if (mode == Syntonic)
+    scope.forEach([this, &c](int index) { commandQueue[index] = c; });
+    ++commandsPushed;
+    return true;
+}
+
+void LatticesProcessor::waitForCommands()
+{
+    // Only ever called from non-realtime renders, where blocking is allowed
+    while (commandsApplied < commandsPushed && isThreadRunning())
+    {
+        commandsDone.wait(10);
+    }
+}
+
+void LatticesProcessor::run()
+{
+    while (!threadShouldExit())
     {
-        float quarter = static_cast<float>(positionX) / 4;
-        int syntYOff = std::floor(quarter);
-        syntYOff *= -1;
+        {
+            SlotPin pin{tuningSlotPin, customSlot};
+            serviceCommands();
+        }
+        
+        wait(1);
+    }
+}
 
-        positionY = yParam->get() + syntYOff;
+void LatticesProcessor::serviceCommands()
+{
+    if (scaleChanged.exchange(false))
+        applyScaleSize();
+    
+    // The custom mode's old tables might be cached, and if it's the one playing, retune
+    if (customModeChanged.exchange(false))
+    {
+        tuningCache.clear();
+        if (mode == ScaleModes::custom)
+            locateRequested = true;
     }
     
-    int nn = originalRefNote;
-    double nf = 1.0;
+    if (resetRequested.exchange(false))
+        returnToOrigin();
+    
+    // Navigation is applied a group at a time: everything from one block, or from one
+    // coalescing window, becomes a single net move with one retune. A block's group
+    // goes as soon as processBlock is done with it, a window's once the window has
+    // passed. Groups that aren't complete yet stay in the queue.
+    int start1, size1, start2, size2;
+    commandFifo.prepareToRead(commandFifo.getNumReady(), start1, size1, start2, size2);
     
-    int absx = std::abs(positionX);
-    double mul = positionX < 0 ? 1 / 1.5 : 1.5; // fifth down : fifth up
-    int add = positionX < 0 ? -7 : 7;
-    for (int i = 0; i < absx; ++i)
+    auto at = [&](int i) -> const NavCommand & {
+        return commandQueue[i < size1 ? start1 + i : start2 + i - size1];
+    };
+    
+    auto now = juce::Time::getMillisecondCounterHiRes();
+    double window = coalesceMs;
+    uint64_t finished = blocksFinished;
+    int total = size1 + size2;
+    int done = 0;
+    
+    while (done < total)
     {
-        nn += add;
-        nf *= mul;
+        const auto &first = at(done);
+        auto inGroup = [&](const NavCommand &c) {
+            return (window > 0) ? c.time <= first.time + window : c.block == first.block;
+        };
+        
+        int end = done + 1;
+        bool urgent = first.urgent;
+        while (end < total && inGroup(at(end)))
+            urgent = urgent || at(end++).urgent;
+        
+        // A chord's notes are already sounding, so its move goes with the block it came in
+        bool blockDone = at(end - 1).block < finished;
+        bool complete = (end < total) || ((window > 0) ? now >= first.time + window || (urgent && blockDone)
+                                                       : blockDone);
+        if (!complete)
+            break;
+        
+        applyGroup(at, done, end);
+        navigationEvents += end - done;
+        ++navigationRetunes;
+        done = end;
+        
+        if (locateRequested.exchange(false))
+            locate();
     }
     
-    int absy = std::abs(positionY);
-    mul = positionY < 0 ? 1 / 1.25 : 1.25; // third down : third up
-    add = positionY < 0 ? -4 : 4;
-    for (int i = 0; i < absy; ++i)
+    commandFifo.finishedRead(done);
+    
+    if (locateRequested.exchange(false))
+        locate();
+    
+    publishChannels();
+    
+    if (done > 0)
     {
-        nn += add;
-        nf *= mul;
+        commandsApplied += done;
+        commandsDone.signal();
     }
+}
+
+template <typename Queue>
+void LatticesProcessor::applyGroup(Queue &&at, int begin, int end)
+{
+    int64_t x = latticeX;
+    int64_t y = latticeY;
+    bool moved = false;
+    bool home = false;
+    
+    int axes[numExtraAxes];
+    for (int a = 0; a < numExtraAxes; ++a)
+        axes[a] = extraAxes[a];
+    bool axesMoved = false;
     
-    while (nn < 0)
+    for (int i = begin; i < end; ++i)
     {
-        nn += 12;
-        nf *= 2.0;
+        const auto &c = at(i);
+        
+        // The extra axes move every channel's lattice together
+        if (c.dir == AxisUp || c.dir == AxisDown)
+        {
+            auto &a = axes[juce::jlimit(0, numExtraAxes - 1, static_cast<int>(c.value))];
+            a = juce::jlimit(-maxExtraDistance, maxExtraDistance, a + ((c.dir == AxisUp) ? 1 : -1));
+            axesMoved = true;
+            continue;
+        }
+        
+        if (multiChannel && c.channel != listenOnChannel)
+        {
+            shiftChannel(c.channel - 1, c);
+            continue;
+        }
+        
+        // Clamped as we go, so pushing against the edge doesn't have to be undone
+        switch (c.dir)
+        {
+            case West:
+                x = std::max(x - 1, -maxPosition);
+                break;
+            case East:
+                x = std::min(x + 1, maxPosition);
+                break;
+            case North:
+                y = std::min(y + 1, maxPosition);
+                break;
+            case South:
+                y = std::max(y - 1, -maxPosition);
+                break;
+            case Home:
+                x = 0;
+                y = 0;
+                home = true;
+                for (auto &a : axes)
+                    a = 0;
+                axesMoved = true;
+                break;
+            case SetX:
+                x = juce::jlimit(-maxPosition, maxPosition, c.value);
+                break;
+            case SetY:
+                y = juce::jlimit(-maxPosition, maxPosition, c.value);
+                break;
+        };
+        moved = true;
     }
-    while (nn >= 12)
+    
+    if (axesMoved)
     {
-        nn -= 12;
-        nf *= 0.5;
+        for (int a = 0; a < numExtraAxes; ++a)
+            extraAxes[a] = axes[a];
+        extraAxesChanged = true;
+        locateRequested = true;
+        hostDisplayChanged = true;
     }
     
-    currentRefNote = nn;
-    currentRefFreq = originalRefFreq * nf;
+    // Home puts the view back around the origin too, like returnToOrigin
+    if (home)
+    {
+        viewX = 0;
+        viewY = 0;
+    }
     
-    for (int i = 0; i < 12; ++i)
+    if (moved)
+        moveTo(x, y);
+}
+
+
+
+void LatticesProcessor::moveTo(int64_t x, int64_t y)
+{
+    x = juce::jlimit(-maxPosition, maxPosition, x);
+    y = juce::jlimit(-maxPosition, maxPosition, y);
+    latticeX = x;
+    latticeY = y;
+    
+    // Slide the view just far enough to keep the position in it
+    auto follow = [](std::atomic<int64_t> &view, int64_t p) {
+        if (p > view + maxDistance)
+            view = p - maxDistance;
+        else if (p < view - maxDistance)
+            view = p + maxDistance;
+        return static_cast<int>(p - view);
+    };
+    int px = follow(viewX, x);
+    int py = follow(viewY, y);
+    
+    movingParams = true;
+    
+    if (px != xParam->get())
     {
-        coOrds[i].first = duoCo[i].first + positionX;
-        coOrds[i].second = duoCo[i].second + positionY;
+        xParam->beginChangeGesture();
+        xParam->setValueNotifyingHost(GNV(px));
+        xParam->endChangeGesture();
     }
     
-    if (mode == Syntonic)
+    if (py != yParam->get())
     {
-        int syntShape = ((positionX % 4) + 4) % 4;
-
-        ratios[6] = (syntShape > 0) ? (double)36/25 : (double)45/32;
-        ratios[11] = (syntShape > 1) ? (double)48/25 : (double)15/8;
-        ratios[4] = (syntShape == 3) ? (double)32/25 : (double)5/4;
+        yParam->beginChangeGesture();
+        yParam->setValueNotifyingHost(GNV(py));
+        yParam->endChangeGesture();
+    }
+    
+    movingParams = false;
+    hostDisplayChanged = true;
+    
+    // The parameters don't always move (not when the view does instead), so don't
+    // leave the retune to them
+    locateRequested = true;
+}
+    
+void LatticesProcessor::followParams()
+{
+    // Host automation moves the position within the view
+    if (hostMovedParams.exchange(false))
+    {
+        latticeX = viewX + xParam->get();
+        latticeY = viewY + yParam->get();
+    }
+    
+    int64_t x = latticeX;
+    int64_t y = latticeY;
+    positionX = x;
+    positionY = adjustY(x, y);
+    
+    auto &main = channels[juce::jlimit(1, 16, listenOnChannel.load()) - 1];
+    main.x = x;
+    main.y = y;
+    
+    // The two commas only close the lattice up at 12 notes
+    if (scale.size != 12)
+        drift.reset();
+    else
+        drift.move(positionX - drift.x(), positionY - drift.y());
+    syntonicDrift = drift.count(JIMath::syntonic);
+    diesisDrift = drift.count(JIMath::diesis);
+    driftCents = drift.cents();
+}
 
-        coOrds[6].second = (syntShape > 0) ? positionY - 2 : positionY + 1;
-        coOrds[11].second =  (syntShape > 1) ? positionY - 2 : positionY + 1;
-        coOrds[4].second = (syntShape == 3) ? positionY - 2 : positionY + 1;
+void LatticesProcessor::locate()
+{
+    if (extraAxesChanged.exchange(false))
+        updateOffPlane();
+    
+    followParams();
+    
+    double limit = recenterCents;
+    if (limit > 0 && std::abs(drift.cents()) > limit)
+    {
+        // Take the commas back out: the same note names, back in the block around the origin
+        moveTo(drift.blockX, drift.blockY - adjustY(drift.blockX, 0));
+        locateRequested = false;
+        followParams();
+    }
+    
+    int64_t px = positionX;
+    int64_t py = positionY;
+    
+    int m = slotOf(mode);
+    // Whole tables are memoized per position, so going back somewhere is a lookup and a publish
+    bool useCache = scale.size == 12;
+    if (useCache)
+    {
+        tuningCache.rebase(originalRefNote, originalRefFreq);
+        if (auto *e = tuningCache.find(m, px, py))
+        {
+            currentRefNote = e->refNote;
+            currentRefFreq = e->refFreq;
+            std::copy(e->coOrds, e->coOrds + 12, coOrds);
+            
+            // A copy, not the entry itself: the cache rewrites entries as it goes.
+            // freqs didn't come from ratios this time, so the next updateTuning
+            // builds in full.
+            std::copy(e->freqs, e->freqs + 128, freqs);
+            tunedRefNote = -1;
+            publish();
+            return;
+        }
+    }
+    else if (!tuningCache.empty())
+    {
+        tuningCache.clear();
     }
+    
+    findReference(px, py, currentRefNote, currentRefFreq);
+    findShape(px, py, ratios, coOrds, m);
     updateTuning();
+    
+    if (useCache)
+    {
+        if (auto *e = tuningCache.insert(m, px, py))
+        {
+            std::copy(freqs, freqs + 128, e->freqs);
+            std::copy(coOrds, coOrds + 12, e->coOrds);
+            e->refNote = currentRefNote;
+            e->refFreq = currentRefFreq;
+        }
+    }
+}
+
+void LatticesProcessor::updateOffPlane()
+{
+    int position[numExtraAxes];
+    primeLattice.clear();
+    for (int a = 0; a < numExtraAxes; ++a)
+    {
+        primeLattice.addAxis(extraPrimes[a]);
+        position[a] = extraAxes[a];
+    }
+    
+    auto e = primeLattice.at(position);
+    offPlaneSteps = PrimeLattice::steps(e, scale.size);
+    offPlaneRatio = PrimeLattice::ratio(e);
+    
+    // Everything cached, and every channel, was tuned for the old offset
+    tuningCache.clear();
+    for (auto &c : channels)
+        c.dirty = true;
+}
+
+int64_t LatticesProcessor::adjustY(int64_t x, int64_t y) const
+{
+    if (activeScaleSize == 12)
+        return modeTables[slotOf(mode)].adjustY(x, y);
+    return y;
+}
+
+void LatticesProcessor::findReference(int64_t x, int64_t y, int &note, double &freq) const
+{
+    // fifths are 7 semitones, thirds 4, then take out however many octaves that adds up to
+    // the extra axes only ever add a fixed offset on top of the plane
+    int n = scale.size;
+    int64_t nn = originalRefNote + offPlaneSteps + scale.fifthSteps * x + scale.thirdSteps * y;
+    int64_t octaves = (nn >= 0) ? nn / n : -((n - 1 - nn) / n);
+    
+    note = static_cast<int>(nn - n * octaves);
+    
+    // That leaves the comma drift, about 2 cents a fifth and 14 a third at 12, so take
+    // out whole octaves of it too. The reference then stays within half an octave of
+    // the note the steps put it on, however far the lattice goes.
+    double drift = (double)x * (JIMath::log2Primes[1] - 1) + (double)y * (JIMath::log2Primes[2] - 2)
+                 - (double)(nn - originalRefNote - offPlaneSteps) / n;
+    octaves += std::llround(drift);
+    
+    double base = originalRefFreq * offPlaneRatio;
+    if (x >= -powerRange && x <= powerRange && y >= -powerRange && y <= powerRange)
+        freq = base * std::ldexp(powers.fifth((int)x) * powers.third((int)y), (int)-octaves);
+    else
+        freq = base * std::exp2(JIMath::log2Position(x, y, x + 2 * y + octaves));
+}
+
+void LatticesProcessor::findShape(int64_t x, int64_t y, double *r, std::pair<int64_t, int64_t> *c, int m) const
+{
+    if (scale.size != 12)
+    {
+        for (int i = 0; i < scale.size; ++i)
+        {
+            r[i] = scale.ratios[i];
+            c[i].first = scale.coOrds[i].first + x;
+            c[i].second = scale.coOrds[i].second + y;
+        }
+        return;
+    }
+    
+    // m is a slot, the shape depends on where X is within the mode's period
+    const auto &t = modeTables[m];
+    int phase = t.phaseOf(x);
+    const auto &sr = t.ratios[phase];
+    const auto &sc = t.coOrds[phase];
+    
+    for (int i = 0; i < 12; ++i)
+    {
+        r[i] = sr[i];
+        c[i].first = sc[i].first + x;
+        c[i].second = sc[i].second + y;
+    }
 }
 
 void LatticesProcessor::updateTuning()
+{
+    jassert(currentRefNote >= 0 && currentRefNote < scale.size);
+    
+    if (currentRefNote == tunedRefNote && std::equal(ratios, ratios + scale.size, tunedRatios))
+    {
+        // Only the reference frequency moved, so rescale the table we already have
+        if (currentRefFreq != tunedRefFreq)
+        {
+            TuningTable::rescale(freqs, currentRefFreq / tunedRefFreq);
+        }
+    }
+    else
+    {
+        TuningTable::build(scale.size, currentRefNote, currentRefFreq, ratios, freqs);
+        
+        tunedRefNote = currentRefNote;
+        std::copy(ratios, ratios + scale.size, tunedRatios);
+    }
+    tunedRefFreq = currentRefFreq;
+    
+    publish();
+}
+
+void LatticesProcessor::publish()
 {
     changed = true;
     
-    int refMidiNote = currentRefNote + 60;
-    for (int note = 0; note < 128; ++note)
+    // Without MTS-ESP the lattice still moves, nothing is sent. Registering
+    // later resets to the origin and sends everything.
+    if (!registeredMTS)
+        return;
+    
+    if (mtsReset.exchange(false))
     {
-        double octaveShift = std::pow(2, std::floor(((double)note - refMidiNote) / 12.0));
+        globalPublisher.invalidate();
+        for (auto &p : channelPublishers)
+            p.invalidate();
+        publishedName.clear();
+    }
+    
+    notesPublished += globalPublisher.send(freqs,
+        [](int note, double f) { MTS_SetNoteTuning(f, static_cast<char>(note)); },
+        [](const double *t) { MTS_SetNoteTunings(t); });
+    
+    if (multiChannelActive)
+        publishChannel(mainChannel, freqs);
+    
+    publishName();
+}
+
+void LatticesProcessor::publishChannel(int ch, const double *table)
+{
+    auto c = static_cast<char>(ch);
+    notesPublished += channelPublishers[ch].send(table,
+        [c](int note, double f) { MTS_SetMultiChannelNoteTuning(f, static_cast<char>(note), c); },
+        [c](const double *t) { MTS_SetMultiChannelNoteTunings(t, c); });
+}
+
+void LatticesProcessor::publishName()
+{
+    // Says what the tuning is rather than where, so it changes rarely, and is only sent when it does
+    std::string name = "Lattices";
+    if (scale.size == 12)
+        name += std::string(" ") + modeTables[slotOf(mode)].name;
+    else
+        name += " " + std::to_string(scale.size) + " notes";
+    
+    for (int a = 0; a < primeLattice.numAxes && a < numExtraAxes; ++a)
+    {
+        int steps = extraAxes[a];
+        if (steps == 0)
+            continue;
         
-        int degree = (note - refMidiNote) % 12;
-        if (degree < 0) {degree += 12;}
+        const auto &axis = primeLattice.axes[a];
+        name += ", " + std::to_string(JIMath::primes[axis.prime]) + "/" + std::to_string(1 << -axis.step.e[0])
+              + ((steps > 0) ? " +" : " ") + std::to_string(steps);
+    }
+    
+    if (name != publishedName)
+    {
+        MTS_SetScaleName(name.c_str());
+        publishedName = name;
+    }
+}
+
+void LatticesProcessor::shiftChannel(int ch, const NavCommand &command)
+{
+    auto &c = channels[ch];
+    
+    switch (command.dir)
+    {
+        case West:
+            c.x = std::max(c.x - 1, -maxPosition);
+            break;
+        case East:
+            c.x = std::min(c.x + 1, maxPosition);
+            break;
+        case North:
+            c.y = std::min(c.y + 1, maxPosition);
+            break;
+        case South:
+            c.y = std::max(c.y - 1, -maxPosition);
+            break;
+        case Home:
+            c.x = 0;
+            c.y = 0;
+            break;
+        case SetX:
+            c.x = juce::jlimit(-maxPosition, maxPosition, command.value);
+            break;
+        case SetY:
+            c.y = juce::jlimit(-maxPosition, maxPosition, command.value);
+            break;
+    };
+    
+    c.dirty = true;
+    hostDisplayChanged = true;
+}
+
+void LatticesProcessor::publishChannels()
+{
+    if (!registeredMTS)
+        return;
+    
+    int listening = juce::jlimit(1, 16, listenOnChannel.load()) - 1;
+    bool wanted = multiChannel;
+    
+    if (wanted != multiChannelActive || (wanted && listening != mainChannel))
+    {
+        for (int ch = 0; ch < 16; ++ch)
+        {
+            MTS_SetMultiChannel(wanted, static_cast<char>(ch));
+            channels[ch].dirty = true;
+            channelPublishers[ch].invalidate();
+        }
+        multiChannelActive = wanted;
+        mainChannel = listening;
         
-        freqs[note] = currentRefFreq * ratios[degree] * octaveShift;
+        if (wanted)
+            publishChannel(mainChannel, freqs);
     }
     
-    MTS_SetNoteTunings(freqs);
+    if (!multiChannelActive)
+        return;
     
-    // later...
-    MTS_SetScaleName("JI is nice yeah?");
+    // The listening channel is published along with the global table, the rest only
+    // when they moved. Channels sitting on the same spot share one computation.
+    auto &main = channels[mainChannel];
+    main.dirty = false;
+    
+    for (int ch = 0; ch < 16; ++ch)
+    {
+        auto &c = channels[ch];
+        if (!c.dirty)
+            continue;
+        
+        int64_t x = c.x;
+        int64_t y = c.y;
+        const double *same = nullptr;
+        
+        if (x == main.x && y == main.y)
+        {
+            same = freqs;
+        }
+        else
+        {
+            for (int o = 0; o < 16 && same == nullptr; ++o)
+            {
+                auto &other = channels[o];
+                if (o != ch && o != mainChannel && !other.dirty && other.x == x && other.y == y)
+                    same = other.freqs;
+            }
+        }
+        
+        if (same != nullptr)
+        {
+            std::copy(same, same + 128, c.freqs);
+        }
+        else
+        {
+            int64_t py = adjustY(x, y);
+            int note;
+            double f;
+            double r[ScaleShape::maxSize];
+            std::pair<int64_t, int64_t> co[ScaleShape::maxSize];
+            
+            findReference(x, py, note, f);
+            findShape(x, py, r, co, slotOf(mode));
+            TuningTable::build(scale.size, note, f, r, c.freqs);
+        }
+        
+        publishChannel(ch, c.freqs);
+        c.dirty = false;
+    }
 }
 
 inline float LatticesProcessor::GNV(int input)
@@ -15,14 +15,44 @@
 #include <memory>
 #include <set>
 #include <atomic>
+#include <array>
+#include <algorithm>
+#include <limits>
 #include <cmath>
 #include <iostream>
 #include <string>
 
 #include "JIMath.h"
+#include "TuningCache.h"
+#include "MidiDispatch.h"
+#include "AdaptiveTuner.h"
+#include "PrimeLattice.h"
+#include "ScaleShape.h"
+#include "ScaleModes.h"
+#include "TablePublisher.h"
+#include "TuningTable.h"
 
+// 3/2 and 5/4 raised to every exponent within range, so locate can jump anywhere at once
+template <int range>
+struct LatticePowers
+{
+    constexpr LatticePowers()
+    {
+        for (int i = -range; i <= range; ++i)
+        {
+            fifths[i + range] = JIMath::power(3, i) * JIMath::power(2, -i);
+            thirds[i + range] = JIMath::power(5, i) * JIMath::power(2, -2 * i);
+        }
+    }
+    
+    constexpr double fifth(int x) const { return fifths[x + range]; }
+    constexpr double third(int y) const { return thirds[y + range]; }
+    
+    double fifths[2 * range + 1]{};
+    double thirds[2 * range + 1]{};
+};
 
-class LatticesProcessor : public juce::AudioProcessor, juce::MultiTimer, private juce::AudioProcessorParameter::Listener
+class LatticesProcessor : public juce::AudioProcessor, juce::MultiTimer, private juce::Thread, private juce::AudioProcessorParameter::Listener
 {
 public:
     //==============================================================================
@@ -54,44 +84,133 @@ public:
     
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
     void timerCallback(int timerID) override;
+    void run() override;
     
     void modeSwitch(int m);
+    bool setCustomMode(const juce::String &definition); // false if it doesn't parse or compile
+    bool validMode(int m) const;
+    juce::StringArray getModeNames() const;
     void updateMIDI(int wCC, int eCC, int nCC, int sCC, int hCC, int C);
     void updateFreq(double f);
     double updateRoot(int r);
+    void setDebounceTime(double ms);
+    void setMultiChannel(bool m);
+    void addBinding(const MIDIBinding &b);
+    void clearBindings();
+    void setCoalesceTime(double ms);
+    void setPadRange(int steps);
+    void setNRPN(int xNumber, int yNumber);
+    void setAdaptive(bool a);
+    void setAutoRecenter(double cents);
+    void setExtraAxis(int axis, int steps);
+    void setExtraPrime(int axis, int prime);
+    void setScaleSize(int n);
+    void setAdaptiveSearch(int radius, double budgetMicroseconds);
+    uint64_t getAdaptiveTimeouts() const { return adaptiveTimeouts; }
+    uint64_t getRetunesSaved() const;
+    uint64_t getNotesPublished() const { return notesPublished; }
     void parameterValueChanged(int parameterIndex, float newValue) override;
     
-    bool registeredMTS{false};
+    std::atomic<bool> registeredMTS{false};
     bool MTSreInit{false};
     bool MTStryAgain{false};
     
-    std::atomic<int> positionX{0};
-    std::atomic<int> positionY{0};
+    // Where navigation has taken the lattice, before the mode's Y offset. The host
+    // parameters only see maxDistance either side of viewX/viewY, and the view
+    // follows the position whenever it would leave, so nothing stops at the edge.
+    std::atomic<int64_t> latticeX{0};
+    std::atomic<int64_t> latticeY{0};
+    std::atomic<int64_t> viewX{0};
+    std::atomic<int64_t> viewY{0};
     
-    enum Mode
-    {
-        Duodene,
-        Syntonic,
-    };
-    std::atomic<Mode> mode = Duodene;
+    std::atomic<int64_t> positionX{0};
+    std::atomic<int64_t> positionY{0};
+    
+    std::atomic<int> mode{ScaleModes::Duodene}; // a ScaleModes::Builtin, or ScaleModes::custom
     std::atomic<bool> changed{false};
     std::atomic<int> numClients{0};
     
-    std::pair<int, int> coOrds[12]{};
+    // Notes per octave. The first is what was asked for, the second what coOrds and
+    // the published table are using right now. Modes, adaptive tuning, comma
+    // drift and the tuning cache are all about 12 and only run at 12.
+    std::atomic<int> scaleSize{12};
+    std::atomic<int> activeScaleSize{12};
+    
+    std::pair<int64_t, int64_t> coOrds[ScaleShape::maxSize]{};
     
-    int syntonicDrift = 0;
-    int diesisDrift = 0;
+    // Commas the reference has drifted by, see CommaDrift. Written by the tuning thread.
+    std::atomic<int64_t> syntonicDrift{0};
+    std::atomic<int64_t> diesisDrift{0};
+    std::atomic<double> driftCents{0};
+    
+    // Once drift passes this many cents the lattice folds it back. 0 is off.
+    std::atomic<double> recenterCents{0};
+    
+    // Extra transposition axes, each on a prime past 5 (an index into JIMath::primes,
+    // 7/4 and 11/8 and 13/8 to start with), and how many steps of it the whole 3x5
+    // plane is moved by. That's all they do: every node moves by the same ratio, the
+    // shape and the drawn lattice stay 3x5, and no degree is ever tuned to a higher
+    // prime interval relative to its neighbours.
+    static constexpr int numExtraAxes{3};
+    static constexpr int maxExtraDistance{12};
+    std::atomic<int> extraPrimes[numExtraAxes]{3, 4, 5};
+    std::atomic<int> extraAxes[numExtraAxes]{};
     
     int shiftCCs[5] = {5, 6, 7, 8, 9};
-    int listenOnChannel = 1;
+    std::atomic<int> listenOnChannel{1}; // 0 is omni
+    std::vector<MIDIBinding> bindings; // beyond shiftCCs, message thread only
+    
+    // MIDI learn. While learnAction is an action the audio thread swallows the next
+    // message that could trigger it and leaves it in learnedMessage for the editor,
+    // packed as type << 16 | channel << 8 | number.
+    std::atomic<int> learnAction{-1};
+    std::atomic<int> learnedMessage{-1};
     
-    int originalRefNote{-12};
-    double originalRefFreq{-1};
+    std::atomic<int> originalRefNote{-12};
+    std::atomic<double> originalRefFreq{-1};
+    
+    // How long a navigation CC has to be released before another press counts
+    std::atomic<double> debounceMs{defaultDebounceMs};
+    
+    // Navigation within this many ms is merged into one retune. 0 means per block.
+    std::atomic<double> coalesceMs{0.0};
+    
+    // Absolute positioning. 14-bit and NRPN values are the position plus 8192,
+    // the 7-bit XY pad covers padRange steps either side of the origin.
+    std::atomic<int> padRange{maxDistance};
+    std::atomic<int> nrpnX{-1}; // NRPN parameter numbers, -1 is off
+    std::atomic<int> nrpnY{-1};
+    std::atomic<bool> nrpnConflict{false}; // a direction is on one of the NRPN CCs, see rebuildDispatch
+    
+    // Adaptive JI: held notes on the listening channel move the lattice to wherever
+    // the chord is most in tune, searching at most adaptiveRadius steps away and
+    // giving up on the search after adaptiveBudgetUs.
+    std::atomic<bool> adaptive{false};
+    std::atomic<int> adaptiveRadius{6};
+    std::atomic<double> adaptiveBudgetUs{20.0};
+    
+    // One lattice per MIDI channel, published with MTS-ESP's multi-channel tables.
+    // The listening channel follows the host parameters, the others move on their own.
+    std::atomic<bool> multiChannel{false};
+    struct ChannelLattice
+    {
+        std::atomic<int64_t> x{0};
+        std::atomic<int64_t> y{0};
+        std::atomic<bool> dirty{true};
+        double freqs[128]{};
+    };
+    ChannelLattice channels[16];
     
 private:
-    static constexpr int maxDistance{24};
+    static constexpr int maxDistance{24}; // either side of the view, for the host
+    
+    // How far navigation can go: as far as log2Position stays exact. findReference
+    // folds the comma drift back by octaves, so the table stays in range all the way.
+    static constexpr int64_t maxPosition{JIMath::maxExactSteps};
+    static constexpr int64_t maxView{maxPosition - maxDistance};
     static constexpr int defaultRefNote{0};
     static constexpr double defaultRefFreq{261.6255653005986};
+    static constexpr double defaultDebounceMs{5.0};
     
     juce::AudioParameterInt* xParam;
     juce::AudioParameterInt* yParam;
@@ -107,57 +226,181 @@ private:
         East,
         North,
         South,
-        Home
+        Home,
+        SetX, // absolute, from the command's value
+        SetY,
+        AxisUp, // value is which extra axis
+        AxisDown
     };
     
     void returnToOrigin();
     
-    void respondToMidi(const juce::MidiMessage &m);
-    void shift(int dir);
+    // Navigation is parsed on the audio thread but applied on the tuning thread.
+    // processBlock only ever pushes into this queue, the tuning thread drains it.
+    // A block's commands are applied as soon as the block has been read, in the
+    // order they were played. MTS-ESP tables carry no timestamps, so that's as
+    // close to the notes around them as a retune can get.
+    struct NavCommand
+    {
+        int dir{Home};
+        int channel{0}; // 1-16, only used for per-channel lattices
+        double time{0}; // when it was played, ms on Time::getMillisecondCounterHiRes(), for coalescing
+        uint64_t block{0};
+        int64_t value{0}; // SetX and SetY only
+        bool urgent{false}; // adaptive moves, which never wait for a coalescing window
+    };
+    static constexpr int commandQueueSize{512};
+    juce::AbstractFifo commandFifo{commandQueueSize};
+    std::array<NavCommand, commandQueueSize> commandQueue{};
+    bool pushCommand(const NavCommand &c);
+    void serviceCommands();
+    template <typename Queue>
+    void applyGroup(Queue &&at, int begin, int end);
+    std::atomic<uint64_t> blocksFinished{0};
+    
+    // Navigation commands, and the groups they were applied in. Every command used to
+    // cost a retune and each group costs one, so the difference is what coalescing saved.
+    std::atomic<uint64_t> navigationEvents{0};
+    std::atomic<uint64_t> navigationRetunes{0};
+    std::atomic<bool> movingParams{false};
+    std::atomic<bool> hostMovedParams{false};
+    
+    // Offline renders wait for the tuning thread to catch up before the block returns
+    uint64_t commandsPushed{0};
+    std::atomic<uint64_t> commandsApplied{0};
+    juce::WaitableEvent commandsDone;
+    void waitForCommands();
+    
+    double currentSampleRate{48000};
+    
+    // Requests from the message thread and from the host, picked up by the tuning thread
+    std::atomic<bool> resetRequested{false};
+    std::atomic<bool> locateRequested{false};
+    
+    // Set off the message thread, the host gets told from timer 1
+    std::atomic<bool> hostDisplayChanged{false};
+    
+    void respondToMidi(const juce::MidiMessage &m, int sampleOffset, double time);
+    NavCommand pressCommand(int action, int channel, double time) const;
+    bool learn(const juce::MidiMessage &m); // true if it was taken for learnAction
+    void respondToAbsolute(int action, int channel, int number, double time);
+    void trackNote(int channel, int note, bool on, double time);
+    void adapt();
+    
+    // Built on the message thread, picked up by the audio thread at the top of a block
+    // if it can get the lock without waiting. The audio thread only reads its own copy.
+    MidiDispatch dispatch, pendingDispatch;
+    juce::SpinLock dispatchLock;
+    std::atomic<bool> dispatchChanged{false};
+    void rebuildDispatch();
+    void moveTo(int64_t x, int64_t y);
     void locate();
+    void followParams();
+    CommaDrift drift;
+    
+    // The transposition as one monzo, and what that does to the reference
+    PrimeLattice primeLattice;
+    std::atomic<bool> extraAxesChanged{false};
+    std::atomic<int> offPlaneSteps{0};
+    double offPlaneRatio{1.0};
+    void updateOffPlane();
+    
+    void shiftChannel(int ch, const NavCommand &c);
+    void publishChannels();
+    bool multiChannelActive{false}; // what MTS-ESP has been told
+    int mainChannel{0};
+    
+    // Every mode compiled to a table. The builtins never change, the custom mode
+    // is written to whichever of its two slots isn't live and then swapped in, so
+    // the audio and tuning threads never read a table that's being written.
+    // A pass that began before a swap may still be on the old slot, so each thread
+    // pins the live slot while it works and setCustomMode won't write a pinned one.
+    ModeTable modeTables[ScaleModes::numSlots]{};
+    std::atomic<int> customSlot{ScaleModes::custom};
+    std::atomic<int> audioSlotPin{-1};
+    std::atomic<int> tuningSlotPin{-1};
+    struct SlotPin
+    {
+        SlotPin(std::atomic<int> &p, const std::atomic<int> &live) : pin(p)
+        {
+            // Checked again after pinning, in case the swap came in between
+            int s;
+            do
+            {
+                s = live;
+                pin = s;
+            } while (live != s);
+        }
+        ~SlotPin() { pin = -1; }
+        std::atomic<int> &pin;
+    };
+    std::atomic<bool> hasCustomMode{false};
+    std::atomic<bool> customModeChanged{false};
+    juce::String customModeText; // message thread only
+    int slotOf(int m) const;
+    
+    // The pieces of locate, usable for any position. Y here is after the mode's offset.
+    int64_t adjustY(int64_t x, int64_t y) const;
+    void findReference(int64_t x, int64_t y, int &note, double &freq) const;
+    void findShape(int64_t x, int64_t y, double *r, std::pair<int64_t, int64_t> *c, int m) const;
+    
+    ScaleShape scale; // tuning thread only
+    std::atomic<bool> scaleChanged{false};
+    void applyScaleSize();
     
     void updateTuning();
+    void publish(); // freqs, always
+    
+    // What MTS-ESP was last sent, per table, so only changes go out. Tuning thread
+    // only, apart from mtsReset which says the library forgot everything we sent.
+    TablePublisher globalPublisher;
+    TablePublisher channelPublishers[16];
+    std::string publishedName;
+    std::atomic<bool> mtsReset{false};
+    std::atomic<uint64_t> notesPublished{0};
+    void publishChannel(int ch, const double *table);
+    void publishName();
     
     inline float GNV(int input);
     // GetNormValue... I was getting nonsense from JUCE param one
     
-    double ratios[12] = {};
-    double freqs[128]{};
+    double ratios[ScaleShape::maxSize] = {};
+    double freqs[128]{}; // written by the tuning thread only
+    
+    // Exact powers near the origin, past them findReference works in logs.
+    // Modes can pull Y down by up to a quarter of X, so thirds need a little more room.
+    static constexpr int powerRange{maxDistance + maxDistance / 4 + 1};
+    static constexpr LatticePowers<powerRange> powers{};
+    
+    TuningCache tuningCache{maxDistance, powerRange, ScaleModes::numSlots};
+    
+    // What the current freqs table was built from, so a reference-only move can rescale it
+    int tunedRefNote{-1};
+    double tunedRefFreq{0};
+    double tunedRatios[ScaleShape::maxSize]{};
     
-    double duo12[12]
-    {
-        1.0,
-        (double)16/15,
-        (double)9/8,
-        (double)6/5,
-        (double)5/4,
-        (double)4/3,
-        (double)45/32,
-        (double)3/2,
-        (double)8/5,
-        (double)5/3,
-        (double)9/5,
-        (double)15/8
-    };
-    std::pair<int, int> duoCo[12]
-    {
-        {0, 0},
-        {-1, -1},
-        {2, 0},
-        {1, -1},
-        {0, 1},
-        {-1, 0},
-        {2, 1},
-        {1, 0},
-        {0, -1},
-        {-1, 1},
-        {2, -1},
-        {1, 1}
-    };
     
 
-    bool hold[5] = {false, false, false, false, false};
-    bool wait[5] = {false, false, false, false, false};
+    // CC debounce, all of it on the audio thread and counted in samples. Kept per
+    // message (CCs first, then notes), so two bindings for one action bounce apart.
+    static constexpr int64_t neverReleased{std::numeric_limits<int64_t>::min() / 2};
+    int64_t sampleClock{0};
+    std::atomic<int64_t> debounceSamples{240};
+    bool held[2][16][128]{};
+    int64_t releasedAt[2][16][128]{};
+    
+    // Last value of every CC, for 14-bit pairs, and the NRPN each channel has selected
+    uint8_t ccValues[16][128]{};
+    int nrpnParam[16]{};
+    
+    // Held notes for adaptive mode, also audio thread only. A block with new
+    // notes in it gets one search, after all its MIDI has been read.
+    AdaptiveTuner adaptiveTuner;
+    bool sounding[16][128]{};
+    int pitchClassesHeld[12]{};
+    bool chordChanged{false};
+    double chordTime{0};
+    std::atomic<uint64_t> adaptiveTimeouts{0};
     
 //    juce::AudioProcessorValueTreeState state;
     
@@ -13,10 +13,14 @@
 
 #include <string>
 
+#include "MidiDispatch.h"
+
 //==============================================================================
 struct MIDIMenuComponent :  public juce::Component
 {
-    MIDIMenuComponent(int wCC, int eCC, int nCC, int sCC, int hCC, int C)
+    MIDIMenuComponent(int wCC, int eCC, int nCC, int sCC, int hCC, int C,
+                      int xNRPN, int yNRPN, int range, bool perChannel, double debounce,
+                      double coalesce)
     {
         data[0] = wCC;
         data[1] = eCC;
@@ -24,6 +28,11 @@ struct MIDIMenuComponent :  public juce::Component
         data[3] = sCC;
         data[4] = hCC;
         midiChannel = C;
+        nrpn[0] = xNRPN;
+        nrpn[1] = yNRPN;
+        padRange = range;
+        debounceMs = debounce;
+        coalesceMs = coalesce;
         
         addAndMakeVisible(westLabel);
         westLabel.setJustificationType(juce::Justification::left);
@@ -130,6 +139,116 @@ struct MIDIMenuComponent :  public juce::Component
         channelEditor.onReturnKey = [this]{ returnKeyResponse(&channelEditor); };
         channelEditor.onEscapeKey = [this]{ escapeKeyResponse(&channelEditor); };
         channelEditor.onFocusLost = [this]{ focusLostResponse(&channelEditor); };
+        
+        
+        // Empty is off
+        addAndMakeVisible(nrpnXLabel);
+        nrpnXLabel.setJustificationType(juce::Justification::left);
+        nrpnXLabel.setColour(juce::Label::backgroundColourId, bg);
+        nrpnXLabel.setColour(juce::Label::outlineColourId, ol);
+        
+        addAndMakeVisible(nrpnXEditor);
+        nrpnXEditor.setMultiLine(false);
+        nrpnXEditor.setReturnKeyStartsNewLine(false);
+        nrpnXEditor.setInputRestrictions(5, "1234567890");
+        nrpnXEditor.setText(nrpnText(xNRPN), false);
+        nrpnXEditor.setJustification(juce::Justification::centred);
+        nrpnXEditor.setSelectAllWhenFocused(true);
+        nrpnXEditor.onReturnKey = [this]{ returnKeyResponse(&nrpnXEditor); };
+        nrpnXEditor.onEscapeKey = [this]{ escapeKeyResponse(&nrpnXEditor); };
+        nrpnXEditor.onFocusLost = [this]{ focusLostResponse(&nrpnXEditor); };
+        
+        
+        addAndMakeVisible(nrpnYLabel);
+        nrpnYLabel.setJustificationType(juce::Justification::left);
+        nrpnYLabel.setColour(juce::Label::backgroundColourId, bg);
+        nrpnYLabel.setColour(juce::Label::outlineColourId, ol);
+        
+        addAndMakeVisible(nrpnYEditor);
+        nrpnYEditor.setMultiLine(false);
+        nrpnYEditor.setReturnKeyStartsNewLine(false);
+        nrpnYEditor.setInputRestrictions(5, "1234567890");
+        nrpnYEditor.setText(nrpnText(yNRPN), false);
+        nrpnYEditor.setJustification(juce::Justification::centred);
+        nrpnYEditor.setSelectAllWhenFocused(true);
+        nrpnYEditor.onReturnKey = [this]{ returnKeyResponse(&nrpnYEditor); };
+        nrpnYEditor.onEscapeKey = [this]{ escapeKeyResponse(&nrpnYEditor); };
+        nrpnYEditor.onFocusLost = [this]{ focusLostResponse(&nrpnYEditor); };
+        
+        
+        addAndMakeVisible(padLabel);
+        padLabel.setJustificationType(juce::Justification::left);
+        padLabel.setColour(juce::Label::backgroundColourId, bg);
+        padLabel.setColour(juce::Label::outlineColourId, ol);
+        
+        addAndMakeVisible(padEditor);
+        padEditor.setMultiLine(false);
+        padEditor.setReturnKeyStartsNewLine(false);
+        padEditor.setInputRestrictions(2, "1234567890");
+        padEditor.setText(std::to_string(range), false);
+        padEditor.setJustification(juce::Justification::centred);
+        padEditor.setSelectAllWhenFocused(true);
+        padEditor.onReturnKey = [this]{ returnKeyResponse(&padEditor); };
+        padEditor.onEscapeKey = [this]{ escapeKeyResponse(&padEditor); };
+        padEditor.onFocusLost = [this]{ focusLostResponse(&padEditor); };
+        
+        addAndMakeVisible(debounceLabel);
+        debounceLabel.setJustificationType(juce::Justification::left);
+        debounceLabel.setColour(juce::Label::backgroundColourId, bg);
+        debounceLabel.setColour(juce::Label::outlineColourId, ol);
+        
+        addAndMakeVisible(debounceEditor);
+        debounceEditor.setMultiLine(false);
+        debounceEditor.setReturnKeyStartsNewLine(false);
+        debounceEditor.setInputRestrictions(4, ".1234567890");
+        debounceEditor.setText(juce::String(debounce, 1), false);
+        debounceEditor.setJustification(juce::Justification::centred);
+        debounceEditor.setSelectAllWhenFocused(true);
+        debounceEditor.onReturnKey = [this]{ returnKeyResponse(&debounceEditor); };
+        debounceEditor.onEscapeKey = [this]{ escapeKeyResponse(&debounceEditor); };
+        debounceEditor.onFocusLost = [this]{ focusLostResponse(&debounceEditor); };
+        
+        // 0 is a block at a time
+        addAndMakeVisible(coalesceLabel);
+        coalesceLabel.setJustificationType(juce::Justification::left);
+        coalesceLabel.setColour(juce::Label::backgroundColourId, bg);
+        coalesceLabel.setColour(juce::Label::outlineColourId, ol);
+        
+        addAndMakeVisible(coalesceEditor);
+        coalesceEditor.setMultiLine(false);
+        coalesceEditor.setReturnKeyStartsNewLine(false);
+        coalesceEditor.setInputRestrictions(4, ".1234567890");
+        coalesceEditor.setText(juce::String(coalesce, 1), false);
+        coalesceEditor.setJustification(juce::Justification::centred);
+        coalesceEditor.setSelectAllWhenFocused(true);
+        coalesceEditor.onReturnKey = [this]{ returnKeyResponse(&coalesceEditor); };
+        coalesceEditor.onEscapeKey = [this]{ escapeKeyResponse(&coalesceEditor); };
+        coalesceEditor.onFocusLost = [this]{ focusLostResponse(&coalesceEditor); };
+        
+        // One lattice per MIDI channel
+        multiChannelButton.setToggleState(perChannel, juce::dontSendNotification);
+        multiChannelButton.onClick = [this]{ multiChannelChanged = true; };
+        addAndMakeVisible(multiChannelButton);
+        
+        // MIDI learn: pick an action, press Learn, then move whatever should trigger it
+        actionBox.addItemList({"West", "East", "North", "South", "Home"}, 1);
+        actionBox.addItemList({"X 14-bit", "Y 14-bit", "Pad X", "Pad Y"}, MIDIBinding::X14 + 1);
+        actionBox.addItemList({"Axis 1 Up", "Axis 1 Down", "Axis 2 Up", "Axis 2 Down", "Axis 3 Up", "Axis 3 Down"},
+                              MIDIBinding::Axis1Up + 1);
+        actionBox.setSelectedId(1, juce::dontSendNotification);
+        actionBox.onChange = [this]{ learnChanged = true; };
+        addAndMakeVisible(actionBox);
+        
+        learnButton.setClickingTogglesState(true);
+        learnButton.onClick = [this]{ learnChanged = true; };
+        addAndMakeVisible(learnButton);
+        
+        clearButton.onClick = [this]{ clearRequested = true; };
+        addAndMakeVisible(clearButton);
+        
+        addChildComponent(conflictLabel);
+        conflictLabel.setJustificationType(juce::Justification::left);
+        conflictLabel.setColour(juce::Label::textColourId, juce::Colours::orange);
     }
     
     ~MIDIMenuComponent() {}
@@ -158,12 +277,68 @@ struct MIDIMenuComponent :  public juce::Component
         southEditor.setBounds(80, 80, 30, 20);
         homeEditor.setBounds(80, 105, 30, 20);
         channelEditor.setBounds(80, 130, 30, 20);
+        
+        nrpnXLabel.setBounds(130, 5, 80, 20);
+        nrpnYLabel.setBounds(130, 30, 80, 20);
+        padLabel.setBounds(130, 55, 80, 20);
+        
+        nrpnXEditor.setBounds(210, 5, 40, 20);
+        nrpnYEditor.setBounds(210, 30, 40, 20);
+        padEditor.setBounds(210, 55, 40, 20);
+        debounceLabel.setBounds(130, 80, 80, 20);
+        debounceEditor.setBounds(210, 80, 40, 20);
+        coalesceLabel.setBounds(130, 105, 80, 20);
+        coalesceEditor.setBounds(210, 105, 40, 20);
+        
+        multiChannelButton.setBounds(130, 130, 120, 20);
+        
+        actionBox.setBounds(10, 155, 120, 20);
+        learnButton.setBounds(135, 155, 55, 20);
+        clearButton.setBounds(195, 155, 55, 20);
+        
+        conflictLabel.setBounds(10, 180, 240, 20);
+    }
+    
+    // NRPN needs CCs 6, 38, 98 and 99, so say so when a direction is sitting on one
+    void showConflict(bool c)
+    {
+        conflictLabel.setVisible(c);
+    }
+    
+    // The action to learn, or -1 when Learn isn't down
+    int learning()
+    {
+        return learnButton.getToggleState() ? actionBox.getSelectedId() - 1 : -1;
+    }
+    
+    void learnFinished()
+    {
+        learnButton.setToggleState(false, juce::dontSendNotification);
     }
     
     std::atomic<bool> settingChanged = false;
     int midiChannel;
     int data[5];
     
+    std::atomic<bool> nrpnChanged = false;
+    int nrpn[2]; // X and Y parameter numbers, -1 is off
+    int padRange;
+    
+    std::atomic<bool> debounceChanged = false;
+    double debounceMs;
+    
+    std::atomic<bool> coalesceChanged = false;
+    double coalesceMs;
+    
+    std::atomic<bool> multiChannelChanged = false;
+    bool isMultiChannel()
+    {
+        return multiChannelButton.getToggleState();
+    }
+    
+    std::atomic<bool> learnChanged = false;
+    std::atomic<bool> clearRequested = false;
+    
 private:
     
     juce::Rectangle<int> outline1{10 ,5 ,100, 40};
@@ -179,6 +354,11 @@ private:
     juce::TextEditor southEditor{"South"};
     juce::TextEditor homeEditor{"Home"};
     juce::TextEditor channelEditor{"Channel"};
+    juce::TextEditor nrpnXEditor{"NRPN X"};
+    juce::TextEditor nrpnYEditor{"NRPN Y"};
+    juce::TextEditor padEditor{"Pad Range"};
+    juce::TextEditor debounceEditor{"Debounce"};
+    juce::TextEditor coalesceEditor{"Coalesce"};
     
     juce::Label westLabel{{}, "West CC"};
     juce::Label eastLabel{{}, "East CC"};
@@ -186,6 +366,16 @@ private:
     juce::Label southLabel{{}, "South CC"};
     juce::Label homeLabel{{}, "Home CC"};
     juce::Label channelLabel{{}, "Channel"};
+    juce::Label nrpnXLabel{{}, "NRPN X"};
+    juce::Label nrpnYLabel{{}, "NRPN Y"};
+    juce::Label padLabel{{}, "Pad Range"};
+    juce::Label debounceLabel{{}, "Debounce ms"};
+    juce::Label coalesceLabel{{}, "Coalesce ms"};
+    juce::ToggleButton multiChannelButton{"Per Channel"};
+    juce::ComboBox actionBox;
+    juce::TextButton learnButton{"Learn"};
+    juce::TextButton clearButton{"Clear"};
+    juce::Label conflictLabel{{}, "Move directions off 6, 38, 98, 99 for NRPN"};
 
     
 //    juce::Colour noColour{};
@@ -195,11 +385,11 @@ private:
     
     bool rejectBadInput(int input, bool channel = false)
     {
-        // if it's midi channel, reject if out of range
+        // if it's midi channel, reject if out of range (0 is omni)
         
         if (channel)
         {
-            if (input < 1 || input > 16)
+            if (input < 0 || input > 16)
             {
                 return true;
             }
@@ -301,6 +491,63 @@ private:
             midiChannel = digit;
             settingChanged = true;
         }
+        
+        if (e == &nrpnXEditor || e == &nrpnYEditor)
+        {
+            int i = (e == &nrpnXEditor) ? 0 : 1;
+            int n = e->isEmpty() ? -1 : digit;
+            if (n > 16383 || (n >= 0 && n == nrpn[1 - i]))
+            {
+                e->setText(nrpnText(nrpn[i]));
+                return;
+            }
+            
+            nrpn[i] = n;
+            nrpnChanged = true;
+        }
+        
+        if (e == &padEditor)
+        {
+            if (digit < 1 || digit > 24)
+            {
+                e->setText(std::to_string(padRange));
+                return;
+            }
+            
+            padRange = digit;
+            nrpnChanged = true;
+        }
+        
+        if (e == &debounceEditor)
+        {
+            double ms = e->getText().getDoubleValue();
+            if (ms < 0 || ms > 100)
+            {
+                e->setText(juce::String(debounceMs, 1));
+                return;
+            }
+            
+            debounceMs = ms;
+            debounceChanged = true;
+        }
+        
+        if (e == &coalesceEditor)
+        {
+            double ms = e->getText().getDoubleValue();
+            if (ms < 0 || ms > 100)
+            {
+                e->setText(juce::String(coalesceMs, 1));
+                return;
+            }
+            
+            coalesceMs = ms;
+            coalesceChanged = true;
+        }
+    }
+    
+    static std::string nrpnText(int n)
+    {
+        return (n < 0) ? std::string() : std::to_string(n);
     }
     
     void escapeKeyResponse(juce::TextEditor *e)
@@ -0,0 +1,145 @@
+/*
+  Lattices - A Just-Intonation graphical MTS-ESP Source
+  
+  Copyright 2023-2024 Andreya Ek Frisk and Paul Walker.
+  
+  This code is released under the MIT licence, but do note that it depends
+  on the JUCE library, see licence for more details.
+  
+  Source available at https://github.com/Andreya-Autumn/lattices
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+//==============================================================================
+// One extra way of triggering a navigation action, on top of the five CCs in
+// the MIDI menu. Channel 0 means whatever channel Lattices is listening on.
+struct MIDIBinding
+{
+    enum Type
+    {
+        CC,
+        Note,
+        Program
+    };
+    
+    // Actions 0-4 are the five directions. These ones are CC only and take the
+    // value instead of a press, to put the lattice somewhere directly.
+    enum Absolute
+    {
+        X14 = 8,      // 14-bit pair, bind the MSB (0-31) and its LSB follows at +32
+        Y14,
+        PadX,         // 7-bit, spread over the pad range either side of the origin
+        PadY,
+        NRPNParamMSB, // the NRPN ones are bound for you when NRPN is switched on
+        NRPNParamLSB,
+        NRPNDataMSB,
+        NRPNDataLSB,
+        RPNSelect
+    };
+    
+    // Transpose the 3x5 plane along one of the extra prime axes, pressed like the directions
+    enum Axis
+    {
+        Axis1Up = 20,
+        Axis1Down,
+        Axis2Up,
+        Axis2Down,
+        Axis3Up,
+        Axis3Down
+    };
+    
+    static bool isAbsolute(int action)
+    {
+        return action >= X14 && action <= RPNSelect;
+    }
+    
+    static bool isAxis(int action)
+    {
+        return action >= Axis1Up && action <= Axis3Down;
+    }
+    
+    int type{CC};
+    int number{0};
+    int channel{0};
+    int action{0};
+};
+
+//==============================================================================
+// Channel x number -> action tables for everything that navigates, so the audio
+// thread does one lookup per message whatever the number of bindings.
+struct MidiDispatch
+{
+    static constexpr uint8_t none{0xFF};
+    
+    uint8_t cc[16][128];
+    uint8_t note[16][128];
+    uint8_t program[16][128];
+    
+    MidiDispatch()
+    {
+        clear();
+    }
+    
+    void clear()
+    {
+        std::memset(cc, none, sizeof(cc));
+        std::memset(note, none, sizeof(note));
+        std::memset(program, none, sizeof(program));
+    }
+    
+    // listenChannel is 1-16, or 0 for omni
+    void build(const int *shiftCCs, int numShiftCCs, int listenChannel,
+               const std::vector<MIDIBinding> &bindings)
+    {
+        clear();
+        
+        for (int i = 0; i < numShiftCCs; ++i)
+        {
+            bind(cc, shiftCCs[i], listenChannel, i);
+        }
+        
+        for (const auto &b : bindings)
+        {
+            int ch = (b.channel == 0) ? listenChannel : b.channel;
+            
+            switch (b.type)
+            {
+                case MIDIBinding::CC:
+                    bind(cc, b.number, ch, b.action);
+                    if ((b.action == MIDIBinding::X14 || b.action == MIDIBinding::Y14) && b.number < 32)
+                        bind(cc, b.number + 32, ch, b.action);
+                    break;
+                case MIDIBinding::Note:
+                    bind(note, b.number, ch, b.action);
+                    break;
+                case MIDIBinding::Program:
+                    bind(program, b.number, ch, b.action);
+                    break;
+            }
+        }
+    }
+    
+private:
+    static void bind(uint8_t (&table)[16][128], int number, int channel, int action)
+    {
+        if (number < 0 || number > 127 || channel < 0 || channel > 16 || action < 0 || action >= none)
+            return;
+        
+        if (channel == 0)
+        {
+            for (int ch = 0; ch < 16; ++ch)
+            {
+                table[ch][number] = static_cast<uint8_t>(action);
+            }
+        }
+        else
+        {
+            table[channel - 1][number] = static_cast<uint8_t>(action);
+        }
+    }
+};
@@ -12,38 +12,47 @@
 #pragma once
 
 //==============================================================================
+// One button per mode, in the processor's order, so a button's index is its mode.
+// The last button loads a mode definition from a text file, see ModeDef.
 struct ModeComponent : public juce::ToggleButton
 {
-    ModeComponent(int m)
+    ModeComponent(int m, const juce::StringArray &names)
     {
-        addAndMakeVisible(syntonicButton);
-        syntonicButton.onClick = [this]{ updateToggleState(); };
-        syntonicButton.setClickingTogglesState(true);
-        syntonicButton.setRadioGroupId(1);
+        addAndMakeVisible(loadButton);
+        loadButton.onClick = [this]{ chooseDefinition(); };
         
-        addAndMakeVisible(duodeneButton);
-        duodeneButton.onClick = [this]{ updateToggleState(); };
-        duodeneButton.setClickingTogglesState(true);
-        duodeneButton.setRadioGroupId(1);
+        setModes(names, m);
+    }
+    
+    void setModes(const juce::StringArray &names, int m)
+    {
+        buttons.clear();
         
-        switch (m)
+        for (const auto &n : names)
         {
-            case LatticesProcessor::Syntonic:
-                syntonicButton.setToggleState(true, juce::dontSendNotification);
-                break;
-            case LatticesProcessor::Duodene:
-                duodeneButton.setToggleState(true, juce::dontSendNotification);
-                break;
-            default:
-                duodeneButton.setToggleState(true, juce::dontSendNotification);
-                break;
+            auto *b = buttons.add(new juce::TextButton(n));
+            addAndMakeVisible(b);
+            b->onClick = [this]{ updateToggleState(); };
+            b->setClickingTogglesState(true);
+            b->setRadioGroupId(1);
         }
+        
+        if (!buttons.isEmpty())
+            buttons[juce::isPositiveAndBelow(m, buttons.size()) ? m : 0]->setToggleState(true, juce::dontSendNotification);
+        
+        resized();
     }
     
     void resized() override
     {
-        duodeneButton.setBounds(5,5,100,35);
-        syntonicButton.setBounds(5,45,100,35);
+        // Two columns, the load button after the last mode
+        auto place = [](juce::Component &c, int i) {
+            c.setBounds(5 + (i % 2) * 106, 5 + (i / 2) * 40, 100, 35);
+        };
+        
+        for (int i = 0; i < buttons.size(); ++i)
+            place(*buttons[i], i);
+        place(loadButton, buttons.size());
     }
     
     void updateToggleState()
@@ -61,25 +70,41 @@ struct ModeComponent : public juce::ToggleButton
     
     int whichMode()
     {
-        if (duodeneButton.getToggleState() == true)
-        {
-            return 0;
-        }
-        if (syntonicButton.getToggleState() == true)
+        for (int i = 0; i < buttons.size(); ++i)
         {
-            return 1;
+            if (buttons[i]->getToggleState() == true)
+            {
+                return i;
+            }
         }
         return 0;
     }
     
     bool modeChanged = false;
     
+    // A definition read from a file, for the editor to hand to the processor
+    juce::String definition;
+    bool definitionLoaded = false;
+    
 private:
+    void chooseDefinition()
+    {
+        chooser = std::make_unique<juce::FileChooser>("Load a mode", juce::File{}, "*.txt;*.mode");
+        chooser->launchAsync(juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles,
+                             [this](const juce::FileChooser &fc) {
+            auto f = fc.getResult();
+            if (f.existsAsFile())
+            {
+                definition = f.loadFileAsString();
+                definitionLoaded = true;
+            }
+        });
+    }
+    
     juce::Colour bg = findColour(juce::TextEditor::backgroundColourId);
 
-    juce::TextButton duodeneButton { "Duodene" };
-    juce::TextButton syntonicButton { "Syntonic" };
+    juce::OwnedArray<juce::TextButton> buttons;
+    juce::TextButton loadButton { "Load..." };
+    std::unique_ptr<juce::FileChooser> chooser;
 
 };
-
-
@@ -0,0 +1,88 @@
+/*
+  Lattices - A Just-Intonation graphical MTS-ESP Source
+
+  Copyright 2023-2024 Andreya Ek Frisk and Paul Walker.
+
+  This code is released under the MIT licence, but do note that it depends
+  on the JUCE library, see licence for more details.
+
+  Source available at https://github.com/Andreya-Autumn/lattices
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+
+#include "JIMath.h"
+
+//==============================================================================
+// Lattice axes for any of the primes past 2. Each axis steps by its prime, brought
+// into the octave above 1/1, so the 7 axis is 7/4 and the 11 axis 11/8. Pitches
+// come out of the log tables: log2 of a monzo is a dot product, and so is its
+// rough size in 12-EDO semitones, which says which MIDI note it lands on.
+// The processor only uses a point on these axes as a transposition of the
+// whole 3x5 plane, not as coordinates for the degrees themselves.
+struct PrimeLattice
+{
+    static constexpr int maxAxes{JIMath::limit - 1};
+
+    struct Axis
+    {
+        int prime{1}; // index into JIMath::primes
+        Exponents step;
+    };
+
+    Axis axes[maxAxes];
+    int numAxes{0};
+
+    // Returns the new axis' index, or -1 if there's no room
+    void clear()
+    {
+        numAxes = 0;
+    }
+
+    int addAxis(int prime)
+    {
+        if (numAxes == maxAxes || prime < 1 || prime >= JIMath::limit)
+            return -1;
+
+        auto &a = axes[numAxes];
+        a.prime = prime;
+        a.step = Exponents{};
+        a.step.e[prime] = 1;
+        a.step.e[0] = static_cast<int8_t>(-static_cast<int>(std::floor(JIMath::log2Primes[prime])));
+
+        return numAxes++;
+    }
+
+    Exponents at(const int *position) const
+    {
+        Exponents r;
+        for (int a = 0; a < numAxes; ++a)
+            r += axes[a].step * position[a];
+        return r;
+    }
+
+    static double log2Of(const Exponents &x)
+    {
+        return JIRatio{x}.log2();
+    }
+
+    // How many steps of an n note octave x is, each prime its nearest number of steps
+    static int steps(const Exponents &x, int n)
+    {
+        int s = 0;
+        for (int i = 0; i < Exponents::lanes; ++i)
+        {
+            if (x.e[i] != 0)
+                s += x.e[i] * static_cast<int>(std::lround(n * JIMath::log2Primes[i]));
+        }
+        return s;
+    }
+
+    static double ratio(const Exponents &x)
+    {
+        return JIRatio{x}.toDouble();
+    }
+};
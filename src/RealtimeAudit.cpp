@@ -0,0 +1,250 @@
+/*
+  Lattices - A Just-Intonation graphical MTS-ESP Source
+  
+  Copyright 2023-2024 Andreya Ek Frisk and Paul Walker.
+  
+  This code is released under the MIT licence, but do note that it depends
+  on the JUCE library, see licence for more details.
+  
+  Source available at https://github.com/Andreya-Autumn/lattices
+*/
+
+#include "RealtimeAudit.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#if defined(__GLIBC__)
+#include <dlfcn.h>
+#include <pthread.h>
+
+extern "C"
+{
+void *__libc_malloc(size_t);
+void *__libc_calloc(size_t, size_t);
+void *__libc_realloc(void *, size_t);
+void __libc_free(void *);
+}
+#endif
+
+// The malloc and free below read these, so they mustn't allocate themselves.
+// thread_local in a dlopen'ed plugin can go through __tls_get_addr, which calls
+// malloc the first time a thread touches it. initial-exec TLS never does.
+#if defined(__GLIBC__)
+#define LATTICES_AUDIT_TLS __thread __attribute__((tls_model("initial-exec")))
+#else
+#define LATTICES_AUDIT_TLS thread_local
+#endif
+
+namespace
+{
+LATTICES_AUDIT_TLS bool onAudioThread{false};
+LATTICES_AUDIT_TLS bool reporting{false};
+std::atomic<int> violations{0};
+
+void *rawAlloc(size_t n)
+{
+#if defined(__GLIBC__)
+    return __libc_malloc(n);
+#else
+    return std::malloc(n);
+#endif
+}
+
+void rawFree(void *p)
+{
+#if defined(__GLIBC__)
+    __libc_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+// Forwards to the real stream, complaining first if we're on the audio thread
+struct AuditStreamBuf : std::streambuf
+{
+    explicit AuditStreamBuf(std::ostream &s) : stream(s), original(s.rdbuf(this)) {}
+    ~AuditStreamBuf() override { stream.rdbuf(original); }
+    
+    int overflow(int c) override
+    {
+        RealtimeAudit::violation("console output");
+        return original->sputc(static_cast<char>(c));
+    }
+    
+    std::streamsize xsputn(const char *s, std::streamsize n) override
+    {
+        RealtimeAudit::violation("console output");
+        return original->sputn(s, n);
+    }
+    
+    int sync() override { return original->pubsync(); }
+    
+    std::ostream &stream;
+    std::streambuf *original;
+};
+
+AuditStreamBuf auditCout{std::cout};
+AuditStreamBuf auditCerr{std::cerr};
+}
+
+//==============================================================================
+RealtimeAudit::ScopedAudioThread::ScopedAudioThread(bool armed) : wasArmed(onAudioThread)
+{
+    onAudioThread = armed;
+}
+
+RealtimeAudit::ScopedAudioThread::~ScopedAudioThread()
+{
+    onAudioThread = wasArmed;
+}
+
+void RealtimeAudit::violation(const char *what)
+{
+    if (!onAudioThread || reporting)
+        return;
+    
+    // Reporting allocates and prints, which is fine, just don't report that too
+    reporting = true;
+    ++violations;
+    auto trace = juce::SystemStats::getStackBacktrace();
+    std::fprintf(stderr, "Lattices RT audit: %s on the audio thread\n%s\n", what, trace.toRawUTF8());
+    reporting = false;
+}
+
+int RealtimeAudit::getNumViolations()
+{
+    return violations;
+}
+
+int RealtimeAudit::replayTestStream(juce::AudioProcessor &p, const juce::Array<int> &ccs, int channel,
+                                    double sampleRate, int blockSize, int numBlocks)
+{
+    p.setNonRealtime(false);
+    p.setPlayConfigDetails(0, 2, sampleRate, blockSize);
+    p.prepareToPlay(sampleRate, blockSize);
+    
+    juce::AudioBuffer<float> buffer{2, blockSize};
+    juce::MidiBuffer midi;
+    midi.ensureSize(256);
+    
+    juce::Random rng{1};
+    int before = violations;
+    
+    for (int b = 0; b < numBlocks; ++b)
+    {
+        midi.clear();
+        
+        // Bursts of taps on every binding, some of them several to a block
+        int events = rng.nextInt(4);
+        for (int e = 0; e < events && !ccs.isEmpty(); ++e)
+        {
+            int cc = ccs[rng.nextInt(ccs.size())];
+            int pos = rng.nextInt(blockSize);
+            int val = rng.nextBool() ? 127 : 0;
+            midi.addEvent(juce::MidiMessage::controllerEvent(channel, cc, val), pos);
+        }
+        
+        p.processBlock(buffer, midi);
+    }
+    
+    p.releaseResources();
+    return violations - before;
+}
+
+//==============================================================================
+void *operator new(std::size_t n)
+{
+    RealtimeAudit::violation("allocation (new)");
+    if (auto *ptr = rawAlloc(n ? n : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void *operator new(std::size_t n, std::align_val_t a)
+{
+    RealtimeAudit::violation("allocation (aligned new)");
+    auto align = std::max(sizeof(void *), static_cast<size_t>(a));
+#if defined(_WIN32)
+    if (auto *ptr = _aligned_malloc(n ? n : 1, align))
+        return ptr;
+#else
+    void *ptr = nullptr;
+    if (posix_memalign(&ptr, align, n ? n : 1) == 0)
+        return ptr;
+#endif
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+    if (ptr != nullptr)
+        RealtimeAudit::violation("deallocation (delete)");
+    rawFree(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept
+{
+    if (ptr != nullptr)
+        RealtimeAudit::violation("deallocation (aligned delete)");
+#if defined(_WIN32)
+    _aligned_free(ptr);
+#else
+    rawFree(ptr);
+#endif
+}
+
+void operator delete(void *ptr, std::size_t, std::align_val_t a) noexcept
+{
+    operator delete(ptr, a);
+}
+
+#if defined(__GLIBC__)
+// On glibc we can also catch plain malloc/free and pthread mutexes, which is
+// where juce::CriticalSection and std::mutex end up.
+extern "C"
+{
+void *malloc(size_t n)
+{
+    RealtimeAudit::violation("malloc");
+    return __libc_malloc(n);
+}
+
+void *calloc(size_t n, size_t s)
+{
+    RealtimeAudit::violation("calloc");
+    return __libc_calloc(n, s);
+}
+
+void *realloc(void *ptr, size_t n)
+{
+    RealtimeAudit::violation("realloc");
+    return __libc_realloc(ptr, n);
+}
+
+void free(void *ptr)
+{
+    if (ptr != nullptr)
+        RealtimeAudit::violation("free");
+    __libc_free(ptr);
+}
+
+int pthread_mutex_lock(pthread_mutex_t *m)
+{
+    using LockFn = int (*)(pthread_mutex_t *);
+    static auto realLock = reinterpret_cast<LockFn>(dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+    
+    RealtimeAudit::violation("mutex lock");
+    return realLock(m);
+}
+}
+#endif
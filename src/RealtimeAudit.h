@@ -0,0 +1,50 @@
+/*
+  Lattices - A Just-Intonation graphical MTS-ESP Source
+  
+  Copyright 2023-2024 Andreya Ek Frisk and Paul Walker.
+  
+  This code is released under the MIT licence, but do note that it depends
+  on the JUCE library, see licence for more details.
+  
+  Source available at https://github.com/Andreya-Autumn/lattices
+*/
+
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#ifndef LATTICES_RT_AUDIT
+#define LATTICES_RT_AUDIT 0
+#endif
+
+//==============================================================================
+// Debug aid, enabled with the LATTICES_RT_AUDIT cmake option. While a
+// ScopedAudioThread is alive, allocations, mutex locks and console output on
+// that thread are reported to stderr with a stack trace. In normal builds
+// this all compiles away.
+struct RealtimeAudit
+{
+#if LATTICES_RT_AUDIT
+    struct ScopedAudioThread
+    {
+        explicit ScopedAudioThread(bool armed);
+        ~ScopedAudioThread();
+        
+    private:
+        bool wasArmed;
+    };
+    
+    static void violation(const char *what);
+    static int getNumViolations();
+    
+    // Drives the processor like a host would, with small blocks and a stream of
+    // navigation presses and releases on the given CCs. Returns the violations seen.
+    static int replayTestStream(juce::AudioProcessor &p, const juce::Array<int> &ccs, int channel,
+                                double sampleRate = 48000.0, int blockSize = 32, int numBlocks = 30000);
+#else
+    struct ScopedAudioThread
+    {
+        explicit ScopedAudioThread(bool) {}
+    };
+#endif
+};
@@ -0,0 +1,41 @@
+/*
+  Lattices - A Just-Intonation graphical MTS-ESP Source
+  
+  Copyright 2023-2024 Andreya Ek Frisk and Paul Walker.
+  
+  This code is released under the MIT licence, but do note that it depends
+  on the JUCE library, see licence for more details.
+  
+  Source available at https://github.com/Andreya-Autumn/lattices
+*/
+
+#include "LatticesProcessor.h"
+#include "RealtimeAudit.h"
+
+juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter();
+
+// Replays a navigation-heavy MIDI stream through the processor at 32-sample
+// blocks and exits non-zero if anything on the audio path wasn't real-time safe.
+int main()
+{
+    juce::ScopedJuceInitialiser_GUI juceInit;
+    
+    std::unique_ptr<juce::AudioProcessor> p{createPluginFilter()};
+    auto *lattices = dynamic_cast<LatticesProcessor *>(p.get());
+    if (lattices == nullptr)
+        return 1;
+    
+    // Unregistered, the MIDI is still read and the lattice still moves, only
+    // the MTS-ESP calls are skipped, so the audit still covers the audio path
+    if (!lattices->registeredMTS)
+        std::printf("MTS-ESP not registered, auditing without it\n");
+    
+    juce::Array<int> ccs;
+    for (auto cc : lattices->shiftCCs)
+        ccs.add(cc);
+    
+    int v = RealtimeAudit::replayTestStream(*p, ccs, lattices->listenOnChannel);
+    std::printf("%d real-time violations\n", v);
+    
+    return (v == 0) ? 0 : 1;
+}
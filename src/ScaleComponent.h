@@ -0,0 +1,125 @@
+/*
+  Lattices - A Just-Intonation graphical MTS-ESP Source
+
+  Copyright 2023-2024 Andreya Ek Frisk and Paul Walker.
+
+  This code is released under the MIT licence, but do note that it depends
+  on the JUCE library, see licence for more details.
+
+  Source available at https://github.com/Andreya-Autumn/lattices
+*/
+
+#pragma once
+
+#include <iterator>
+
+#include "ScaleShape.h"
+
+//==============================================================================
+// Notes per octave, whether the lattice picks its own degrees as it moves, and
+// how much comma drift it puts up with before folding back
+struct ScaleComponent : public juce::Component
+{
+    ScaleComponent(int size, bool adaptive, double recenter)
+    {
+        int id = 1;
+        for (auto s : ScaleShape::supportedSizes)
+        {
+            sizeBox.addItem(juce::String(s) + " notes", id);
+            if (s == size)
+                sizeBox.setSelectedId(id, juce::dontSendNotification);
+            ++id;
+        }
+        sizeBox.onChange = [this]{ sizeChanged = true; };
+        addAndMakeVisible(sizeBox);
+
+        adaptiveButton.setToggleState(adaptive, juce::dontSendNotification);
+        adaptiveButton.onClick = [this]{ adaptiveChanged = true; };
+        addAndMakeVisible(adaptiveButton);
+        
+        addAndMakeVisible(recenterLabel);
+        recenterLabel.setJustificationType(juce::Justification::left);
+        
+        // Empty or 0 is off
+        recenterCents = recenter;
+        addAndMakeVisible(recenterEditor);
+        recenterEditor.setMultiLine(false);
+        recenterEditor.setReturnKeyStartsNewLine(false);
+        recenterEditor.setInputRestrictions(6, ".1234567890");
+        recenterEditor.setText(centsText(recenter), false);
+        recenterEditor.setJustification(juce::Justification::centred);
+        recenterEditor.setSelectAllWhenFocused(true);
+        recenterEditor.onReturnKey = [this]{ returnKeyResponse(&recenterEditor); };
+        recenterEditor.onEscapeKey = [this]{ escapeKeyResponse(&recenterEditor); };
+        recenterEditor.onFocusLost = [this]{ escapeKeyResponse(&recenterEditor); };
+    }
+
+    void resized() override
+    {
+        sizeBox.setBounds(5, 5, 100, 30);
+        adaptiveButton.setBounds(111, 5, 100, 30);
+        recenterLabel.setBounds(5, 40, 150, 25);
+        recenterEditor.setBounds(155, 40, 56, 25);
+    }
+
+    void paint(juce::Graphics &g) override
+    {
+        g.setColour(findColour(juce::TextEditor::backgroundColourId));
+        g.fillRect(this->getLocalBounds());
+        g.setColour(juce::Colours::lightgrey);
+        g.drawRect(this->getLocalBounds());
+    }
+
+    int whichSize()
+    {
+        int i = sizeBox.getSelectedId() - 1;
+        return juce::isPositiveAndBelow(i, (int)std::size(ScaleShape::supportedSizes))
+                   ? ScaleShape::supportedSizes[i]
+                   : 12;
+    }
+
+    bool isAdaptive()
+    {
+        return adaptiveButton.getToggleState();
+    }
+
+    bool sizeChanged = false;
+    bool adaptiveChanged = false;
+    bool recenterChanged = false;
+    
+    double recenterCents{0};
+
+private:
+    juce::ComboBox sizeBox;
+    juce::ToggleButton adaptiveButton{"Adaptive"};
+    juce::Label recenterLabel{{}, "Recenter past (cents)"};
+    juce::TextEditor recenterEditor{"Recenter"};
+    
+    juce::Range<int> noRange{};
+    
+    static juce::String centsText(double c)
+    {
+        return (c > 0) ? juce::String(c, 1) : juce::String();
+    }
+    
+    void returnKeyResponse(juce::TextEditor *e)
+    {
+        e->setHighlightedRegion(noRange);
+        this->unfocusAllComponents();
+        auto input = e->getText().getDoubleValue();
+        
+        if (input < 0 || input > 1200)
+        {
+            e->setText(centsText(recenterCents));
+            return;
+        }
+        recenterCents = input;
+        recenterChanged = true;
+    }
+    
+    void escapeKeyResponse(juce::TextEditor *e)
+    {
+        e->setHighlightedRegion(noRange);
+        this->unfocusAllComponents();
+    }
+};
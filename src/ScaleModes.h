@@ -0,0 +1,267 @@
+/*
+  Lattices - A Just-Intonation graphical MTS-ESP Source
+
+  Copyright 2023-2024 Andreya Ek Frisk and Paul Walker.
+
+  This code is released under the MIT licence, but do note that it depends
+  on the JUCE library, see licence for more details.
+
+  Source available at https://github.com/Andreya-Autumn/lattices
+*/
+
+#pragma once
+
+#include <utility>
+#include <string>
+#include <sstream>
+#include <cstdlib>
+#include <algorithm>
+
+#include "JIMath.h"
+
+//==============================================================================
+// A mode says which lattice point each of the 12 degrees uses, relative to the
+// reference. Some modes change shape as X moves: a mode repeats every `period`
+// fifths, and over each period the whole block moves `periodY` thirds, so after
+// four fifths Syntonic is a syntonic comma lower. Within a period a degree can
+// wrap, moving by (wrapX, wrapY) from phase `wrapAt` on.
+struct ModeDef
+{
+    struct Degree
+    {
+        int x{0};
+        int y{0};
+        int wrapAt{0}; // 0 never wraps
+        int wrapX{0};
+        int wrapY{0};
+    };
+
+    char name[16]{};
+    int period{1};
+    int periodY{0};
+    Degree degrees[12]{};
+
+    // One setting or degree per line, # to the end of a line is a comment:
+    //
+    //   name Syntonic
+    //   period 4 -1
+    //   6 2 1 from 1 0 -3
+    //
+    // A degree line is the degree, its x and y, then optionally the phase it
+    // wraps from and where it wraps to. Every degree needs a line.
+    static bool parse(const std::string &text, ModeDef &out)
+    {
+        ModeDef d;
+        bool seen[12]{};
+
+        std::istringstream lines(text);
+        std::string line;
+        while (std::getline(lines, line))
+        {
+            line = line.substr(0, line.find('#'));
+
+            std::istringstream in(line);
+            std::string word;
+            if (!(in >> word))
+                continue;
+
+            if (word == "name")
+            {
+                std::string n;
+                std::getline(in >> std::ws, n);
+                n = n.substr(0, sizeof(d.name) - 1);
+                std::copy(n.begin(), n.end(), d.name);
+                d.name[n.size()] = 0;
+                continue;
+            }
+
+            if (word == "period")
+            {
+                if (!(in >> d.period >> d.periodY))
+                    return false;
+                continue;
+            }
+
+            char *end = nullptr;
+            long deg = std::strtol(word.c_str(), &end, 10);
+            if (*end != 0 || deg < 0 || deg >= 12 || seen[deg])
+                return false;
+
+            auto &g = d.degrees[deg];
+            if (!(in >> g.x >> g.y))
+                return false;
+
+            if (in >> word)
+            {
+                if (word != "from" || !(in >> g.wrapAt >> g.wrapX >> g.wrapY) || g.wrapAt < 1)
+                    return false;
+            }
+            seen[deg] = true;
+        }
+
+        for (auto s : seen)
+        {
+            if (!s)
+                return false;
+        }
+
+        out = d;
+        return true;
+    }
+};
+
+//==============================================================================
+// A mode compiled into a flat table: ratios and offsets for every phase, so any
+// position's shape is one modulo and a row of loads however the mode was made.
+struct ModeTable
+{
+    static constexpr int maxPhases{12};
+
+    // Keeps cell() inside 64 bits and Y within what the power tables reach
+    static constexpr int maxOffsetX{12};
+    static constexpr int maxOffsetY{6};
+
+    char name[16]{};
+    int period{1};
+    int periodY{0};
+    double ratios[maxPhases][12]{};
+    std::pair<int, int> coOrds[maxPhases][12]{};
+
+    // 3^x 5^y brought into [1, 2), rounded once
+    static constexpr double cell(int x, int y)
+    {
+        uint64_t num = 1, den = 1;
+        (x > 0 ? num : den) *= JIMath::ipow(3, x > 0 ? x : -x);
+        (y > 0 ? num : den) *= JIMath::ipow(5, y > 0 ? y : -y);
+
+        while (num < den)
+            num *= 2;
+        while (num >= 2 * den)
+            den *= 2;
+
+        return (double)num / den;
+    }
+
+    // std::abs isn't constexpr until C++23
+    static constexpr int absOf(int v)
+    {
+        return v < 0 ? -v : v;
+    }
+
+    static constexpr int degreeOf(int x, int y)
+    {
+        return ((7 * x + 4 * y) % 12 + 12) % 12;
+    }
+
+    constexpr int phaseOf(int64_t x) const
+    {
+        return static_cast<int>(((x % period) + period) % period);
+    }
+
+    // Where Y really is once the mode's drift per period is taken into account
+    constexpr int64_t adjustY(int64_t x, int64_t y) const
+    {
+        int64_t periods = (x >= 0) ? x / period : -((period - 1 - x) / period);
+        return y + periods * periodY;
+    }
+
+    // False if the definition can't be played: every phase has to put degree 0
+    // on the reference and each other degree on a point that is that degree, in
+    // order of pitch. Y can move at most a quarter of X, like Syntonic does.
+    static constexpr bool compile(const ModeDef &d, ModeTable &t)
+    {
+        if (d.period < 1 || d.period > maxPhases || 4 * absOf(d.periodY) > d.period)
+            return false;
+
+        for (int i = 0; i < 16; ++i)
+            t.name[i] = d.name[i];
+        t.name[15] = 0;
+        t.period = d.period;
+        t.periodY = d.periodY;
+
+        for (int phase = 0; phase < d.period; ++phase)
+        {
+            for (int deg = 0; deg < 12; ++deg)
+            {
+                const auto &g = d.degrees[deg];
+                bool wraps = g.wrapAt > 0 && phase >= g.wrapAt;
+                int x = g.x + (wraps ? g.wrapX : 0);
+                int y = g.y + (wraps ? g.wrapY : 0);
+
+                if (absOf(x) > maxOffsetX || absOf(y) > maxOffsetY || degreeOf(x, y) != deg)
+                    return false;
+                if (deg == 0 && (x != 0 || y != 0))
+                    return false;
+
+                t.coOrds[phase][deg].first = x;
+                t.coOrds[phase][deg].second = y;
+                t.ratios[phase][deg] = cell(x, y);
+
+                if (deg > 0 && !(t.ratios[phase][deg] > t.ratios[phase][deg - 1]))
+                    return false;
+            }
+        }
+        return true;
+    }
+};
+
+//==============================================================================
+struct ScaleModes
+{
+    enum Builtin
+    {
+        Duodene,
+        Syntonic,
+        Pythagorean,
+        Euler,
+        numBuiltins
+    };
+
+    // A user mode comes after the builtins. It has two slots so a new one can be
+    // filled in while the old one is still being read, see LatticesProcessor.
+    static constexpr int custom{numBuiltins};
+    static constexpr int numSlots{numBuiltins + 2};
+
+    // Duodene is the 3x4 block around the reference, fifths -1..2 and thirds -1..1.
+    //
+    // Syntonic keeps the block under the reference as X moves along: over every four
+    // fifths the top row's nodes drop a diesis one at a time, right to left, and the
+    // fourth step is a whole syntonic comma which the period takes care of.
+    //
+    // Pythagorean is the chain of fifths from the minor second to the tritone.
+    //
+    // Euler is his genus diatonico-chromaticum, 3^3 5^2 with the reference in the corner.
+    static constexpr ModeDef builtinDefs[numBuiltins]{
+        {"Duodene", 1, 0, {{0, 0}, {-1, -1}, {2, 0}, {1, -1}, {0, 1}, {-1, 0},
+                           {2, 1}, {1, 0}, {0, -1}, {-1, 1}, {2, -1}, {1, 1}}},
+        {"Syntonic", 4, -1, {{0, 0}, {-1, -1}, {2, 0}, {1, -1}, {0, 1, 3, 0, -3}, {-1, 0},
+                             {2, 1, 1, 0, -3}, {1, 0}, {0, -1}, {-1, 1}, {2, -1}, {1, 1, 2, 0, -3}}},
+        {"Pythagorean", 1, 0, {{0, 0}, {-5, 0}, {2, 0}, {-3, 0}, {4, 0}, {-1, 0},
+                               {6, 0}, {1, 0}, {-4, 0}, {3, 0}, {-2, 0}, {5, 0}}},
+        {"Euler", 1, 0, {{0, 0}, {3, 1}, {2, 0}, {1, 2}, {0, 1}, {3, 2},
+                         {2, 1}, {1, 0}, {0, 2}, {3, 0}, {2, 2}, {1, 1}}},
+    };
+
+    struct Builtins
+    {
+        ModeTable tables[numBuiltins]{};
+        bool ok{true};
+
+        constexpr Builtins()
+        {
+            for (int m = 0; m < numBuiltins; ++m)
+                ok = ModeTable::compile(builtinDefs[m], tables[m]) && ok;
+        }
+    };
+};
+
+inline constexpr ScaleModes::Builtins builtinModes{};
+
+static_assert(builtinModes.ok, "every builtin mode compiles");
+static_assert(builtinModes.tables[ScaleModes::Duodene].ratios[0][1] == (double)16/15
+              && builtinModes.tables[ScaleModes::Duodene].ratios[0][6] == (double)45/32
+              && builtinModes.tables[ScaleModes::Duodene].ratios[0][11] == (double)15/8, "the duodene");
+static_assert(builtinModes.tables[ScaleModes::Syntonic].ratios[1][6] == (double)36/25
+              && builtinModes.tables[ScaleModes::Syntonic].ratios[2][11] == (double)48/25
+              && builtinModes.tables[ScaleModes::Syntonic].ratios[3][4] == (double)32/25,
+              "Syntonic drops a diesis at a time");
@@ -0,0 +1,103 @@
+/*
+  Lattices - A Just-Intonation graphical MTS-ESP Source
+
+  Copyright 2023-2024 Andreya Ek Frisk and Paul Walker.
+
+  This code is released under the MIT licence, but do note that it depends
+  on the JUCE library, see licence for more details.
+
+  Source available at https://github.com/Andreya-Autumn/lattices
+*/
+
+#pragma once
+
+#include <utility>
+#include <cmath>
+#include <cstdlib>
+
+#include "JIMath.h"
+
+//==============================================================================
+// Which lattice point each degree of an N note scale uses. A fifth is however many
+// degrees are closest to 3/2, a third the same for 5/4, and every degree gets the
+// simplest point (by Tenney height) that lands on it. For 12 that would be nearly
+// the duodene, but 12 keeps the real duodene, so it's handed in as it is.
+struct ScaleShape
+{
+    static constexpr int maxSize{53};
+    
+    // Sizes where every degree's point is also in order of pitch
+    static constexpr int supportedSizes[]{5, 7, 12, 17, 19, 22, 31, 41, 53};
+
+    int size{12};
+    int fifthSteps{7};
+    int thirdSteps{4};
+
+    std::pair<int, int> coOrds[maxSize]{}; // relative to the reference
+    double ratios[maxSize]{};
+
+    static int stepsFor(int n, double ratio)
+    {
+        return static_cast<int>(std::lround(n * std::log2(ratio)));
+    }
+
+    static bool validSize(int n)
+    {
+        for (auto s : supportedSizes)
+        {
+            if (s == n)
+                return true;
+        }
+        return false;
+    }
+
+    void build(int n, const double *ratios12, const std::pair<int, int> *coOrds12)
+    {
+        size = n;
+        fifthSteps = stepsFor(n, 1.5);
+        thirdSteps = stepsFor(n, 1.25);
+
+        if (n == 12)
+        {
+            for (int d = 0; d < 12; ++d)
+            {
+                ratios[d] = ratios12[d];
+                coOrds[d] = coOrds12[d];
+            }
+            return;
+        }
+
+        const double fifth = std::log2(3.0);
+        const double third = std::log2(5.0);
+
+        double best[maxSize];
+        for (int d = 0; d < n; ++d)
+            best[d] = -1;
+
+        // Fifths are coprime to every supported size, so this box reaches every degree
+        for (int b = -n / 2; b <= n / 2; ++b)
+        {
+            for (int a = -n; a <= n; ++a)
+            {
+                int d = ((a * fifthSteps + b * thirdSteps) % n + n) % n;
+                double height = std::abs(a) * fifth + std::abs(b) * third;
+
+                if (best[d] < 0 || height < best[d])
+                {
+                    best[d] = height;
+                    coOrds[d] = {a, b};
+                }
+            }
+        }
+
+        for (int d = 0; d < n; ++d)
+        {
+            auto [a, b] = coOrds[d];
+            double r = JIMath::power(3, a) * JIMath::power(5, b);
+
+            // Into whichever octave puts it nearest where degree d would be in n-EDO
+            int octaves = static_cast<int>(std::lround(std::log2(r) - static_cast<double>(d) / n));
+            ratios[d] = std::ldexp(r, -octaves);
+        }
+    }
+};
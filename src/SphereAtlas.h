@@ -0,0 +1,119 @@
+/*
+  Lattices - A Just-Intonation graphical MTS-ESP Source
+
+  Copyright 2023-2024 Andreya Ek Frisk and Paul Walker.
+
+  This code is released under the MIT licence, but do note that it depends
+  on the JUCE library, see licence for more details.
+
+  Source available at https://github.com/Andreya-Autumn/lattices
+*/
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cmath>
+
+//==============================================================================
+// Every kind of sphere, shadows and all, drawn once into one image and then
+// copied wherever it's needed. There are only a few kinds: one per colour,
+// lit or not. Names are kept as small images too. Sheets are per radius
+// and pixel scale. Hold it in a juce::SharedResourcePointer so every open
+// editor uses the same one. Message thread only, apart from the render pool
+// reading images it was handed. Those are software images, so reading them
+// is reading memory and not a native surface tied to the message thread.
+struct SphereAtlas
+{
+    static constexpr int numShades{6};
+    static constexpr int maxSheets{8};
+    static constexpr int maxLabels{512};
+
+    struct Sheet
+    {
+        int radius{0};
+        float scale{1};
+        juce::Image image;
+        juce::Image sprites[numShades][2]; // [shade][lit], parts of image
+        juce::Rectangle<float> bounds;     // of a sprite, around the sphere's centre
+        std::map<std::string, juce::Image> labels[2];
+    };
+
+    // draw(g, shade, lit) paints a sphere centred on 0, 0. bounds has to hold
+    // it, shadows included. Both are in logical pixels.
+    template <typename Draw>
+    Sheet &sheet(int radius, float scale, juce::Rectangle<float> bounds, Draw &&draw)
+    {
+        for (auto &s : sheets)
+        {
+            if (s->radius == radius && std::abs(s->scale - scale) < .01f)
+                return *s;
+        }
+
+        if ((int)sheets.size() == maxSheets)
+            sheets.erase(sheets.begin());
+
+        auto s = std::make_unique<Sheet>();
+        s->radius = radius;
+        s->scale = scale;
+        s->bounds = bounds;
+
+        int w = (int)std::ceil(bounds.getWidth() * scale);
+        int h = (int)std::ceil(bounds.getHeight() * scale);
+        s->image = juce::Image(juce::Image::ARGB, w * numShades, h * 2, true, juce::SoftwareImageType());
+        {
+            juce::Graphics g(s->image);
+            for (int shade = 0; shade < numShades; ++shade)
+            {
+                for (int lit = 0; lit < 2; ++lit)
+                {
+                    juce::Graphics::ScopedSaveState state(g);
+                    g.reduceClipRegion({shade * w, lit * h, w, h});
+                    g.addTransform(juce::AffineTransform::translation(-bounds.getX(), -bounds.getY())
+                                       .scaled(scale)
+                                       .translated((float)(shade * w), (float)(lit * h)));
+                    draw(g, shade, lit == 1);
+                    s->sprites[shade][lit] = s->image.getClippedImage({shade * w, lit * h, w, h});
+                }
+            }
+        }
+
+        sheets.push_back(std::move(s));
+        return *sheets.back();
+    }
+
+    // draw(g) paints the text into 0, 0 to bounds' size
+    template <typename Draw>
+    static const juce::Image &label(Sheet &s, const std::string &text, bool lit, juce::Rectangle<float> bounds,
+                                    Draw &&draw)
+    {
+        auto &labels = s.labels[lit ? 1 : 0];
+        auto it = labels.find(text);
+        if (it != labels.end())
+            return it->second;
+
+        if ((int)labels.size() == maxLabels)
+            labels.clear();
+
+        juce::Image image(juce::Image::ARGB, (int)std::ceil(bounds.getWidth() * s.scale),
+                          (int)std::ceil(bounds.getHeight() * s.scale), true, juce::SoftwareImageType());
+        {
+            juce::Graphics g(image);
+            g.addTransform(juce::AffineTransform::scale(s.scale));
+            draw(g);
+        }
+        return labels[text] = image;
+    }
+
+    // Where an image from the sheet goes so it lands on whole device pixels,
+    // at one image pixel to one device pixel
+    static juce::Rectangle<float> place(const Sheet &s, const juce::Image &image, float x, float y)
+    {
+        return {std::round(x * s.scale) / s.scale, std::round(y * s.scale) / s.scale,
+                image.getWidth() / s.scale, image.getHeight() / s.scale};
+    }
+
+    std::vector<std::unique_ptr<Sheet>> sheets;
+};
@@ -0,0 +1,70 @@
+/*
+  Lattices - A Just-Intonation graphical MTS-ESP Source
+
+  Copyright 2023-2024 Andreya Ek Frisk and Paul Walker.
+
+  This code is released under the MIT licence, but do note that it depends
+  on the JUCE library, see licence for more details.
+
+  Source available at https://github.com/Andreya-Autumn/lattices
+*/
+
+#pragma once
+
+#include <algorithm>
+
+//==============================================================================
+// Remembers the last table sent for one destination and only sends what changed.
+// A few notes go one at a time, past maxSingleNotes the whole table goes in one
+// call, and if nothing changed nothing is sent at all. Every client looks at
+// every update, so with a lot of them connected this is where the time goes.
+struct TablePublisher
+{
+    static constexpr int maxSingleNotes{16};
+
+    // What the other end has is unknown, so the next send is the whole table
+    void invalidate()
+    {
+        valid = false;
+    }
+
+    // note(n, freq) sends one note, all(table) the whole thing. Returns how many
+    // notes went out.
+    template <typename SendNote, typename SendAll>
+    int send(const double *table, SendNote &&note, SendAll &&all)
+    {
+        int changed[128];
+        int n = 0;
+
+        if (valid)
+        {
+            for (int i = 0; i < 128; ++i)
+            {
+                if (table[i] != last[i])
+                    changed[n++] = i;
+            }
+
+            if (n == 0)
+                return 0;
+        }
+
+        if (!valid || n > maxSingleNotes)
+        {
+            all(table);
+            n = 128;
+        }
+        else
+        {
+            for (int i = 0; i < n; ++i)
+                note(changed[i], table[changed[i]]);
+        }
+
+        std::copy(table, table + 128, last);
+        valid = true;
+        return n;
+    }
+
+private:
+    double last[128]{};
+    bool valid{false};
+};
@@ -0,0 +1,150 @@
+/*
+  Lattices - A Just-Intonation graphical MTS-ESP Source
+  
+  Copyright 2023-2024 Andreya Ek Frisk and Paul Walker.
+  
+  This code is released under the MIT licence, but do note that it depends
+  on the JUCE library, see licence for more details.
+  
+  Source available at https://github.com/Andreya-Autumn/lattices
+*/
+
+#pragma once
+
+#include <utility>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+
+//==============================================================================
+// Finished tuning tables, memoized per mode and lattice position. When it fills
+// up the least recently used table makes room. Tables belong to the origin they
+// were built from: a new reference frequency rescales them, a new reference
+// note throws them away.
+struct TuningCache
+{
+    struct Entry
+    {
+        double freqs[128]{};
+        std::pair<int64_t, int64_t> coOrds[12]{};
+        int refNote{0};
+        double refFreq{0};
+    };
+    
+    TuningCache(int maxX, int maxY, int numModes, int cap = 256)
+        : rangeX(maxX), rangeY(maxY), capacity(cap),
+          slots((size_t)(numModes * (2 * maxX + 1) * (2 * maxY + 1)), -1),
+          entries((size_t)cap), keyOf((size_t)cap, -1), prev((size_t)cap, -1), next((size_t)cap, -1)
+    {
+    }
+    
+    const Entry *find(int mode, int64_t x, int64_t y)
+    {
+        int k = key(mode, x, y);
+        if (k < 0 || slots[k] < 0)
+            return nullptr;
+        
+        int i = slots[k];
+        unlink(i);
+        pushFront(i);
+        return &entries[i];
+    }
+    
+    Entry *insert(int mode, int64_t x, int64_t y)
+    {
+        int k = key(mode, x, y);
+        if (k < 0)
+            return nullptr;
+        
+        int i = slots[k];
+        if (i >= 0)
+        {
+            unlink(i);
+        }
+        else if (count < capacity)
+        {
+            i = count++;
+        }
+        else
+        {
+            i = tail;
+            unlink(i);
+            slots[keyOf[i]] = -1;
+        }
+        
+        keyOf[i] = k;
+        slots[k] = i;
+        pushFront(i);
+        return &entries[i];
+    }
+    
+    void rebase(int note, double freq)
+    {
+        if (note != baseNote)
+        {
+            clear();
+        }
+        else if (freq != baseFreq && baseFreq > 0)
+        {
+            double scale = freq / baseFreq;
+            for (int i = 0; i < count; ++i)
+            {
+                for (int n = 0; n < 128; ++n)
+                {
+                    entries[i].freqs[n] *= scale;
+                }
+                entries[i].refFreq *= scale;
+            }
+        }
+        
+        baseNote = note;
+        baseFreq = freq;
+    }
+    
+    void clear()
+    {
+        std::fill(slots.begin(), slots.end(), -1);
+        count = 0;
+        head = -1;
+        tail = -1;
+    }
+    
+    bool empty() const { return count == 0; }
+    
+private:
+    int rangeX, rangeY, capacity;
+    
+    int baseNote{-1};
+    double baseFreq{0};
+    
+    std::vector<int> slots; // key -> entry, or -1
+    std::vector<Entry> entries;
+    std::vector<int> keyOf, prev, next;
+    int count{0}, head{-1}, tail{-1}; // head is most recently used
+    
+    // Only positions near the origin are kept, further out is never a cache hit
+    int key(int mode, int64_t x, int64_t y) const
+    {
+        if (x < -rangeX || x > rangeX || y < -rangeY || y > rangeY)
+            return -1;
+        
+        int k = ((mode * (2 * rangeY + 1)) + ((int)y + rangeY)) * (2 * rangeX + 1) + ((int)x + rangeX);
+        return (k < (int)slots.size()) ? k : -1;
+    }
+    
+    void unlink(int i)
+    {
+        if (prev[i] >= 0) next[prev[i]] = next[i]; else head = next[i];
+        if (next[i] >= 0) prev[next[i]] = prev[i]; else tail = prev[i];
+        prev[i] = next[i] = -1;
+    }
+    
+    void pushFront(int i)
+    {
+        prev[i] = -1;
+        next[i] = head;
+        if (head >= 0) prev[head] = i;
+        head = i;
+        if (tail < 0) tail = i;
+    }
+};
@@ -0,0 +1,116 @@
+/*
+ Lattices - A Just-Intonation graphical MTS-ESP Source
+ 
+ Copyright 2023-2024 Andreya Ek Frisk and Paul Walker.
+ 
+ This code is released under the MIT licence, but do note that it depends
+ on the JUCE library, see licence for more details.
+ 
+ Source available at https://github.com/Andreya-Autumn/lattices
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+
+//==============================================================================
+// For each of the N possible reference notes, which scale degree and which octave
+// multiplier every MIDI note gets. Built at compile time so updateTuning is just
+// a gather and a multiply.
+template <int N>
+struct TuningLayout
+{
+    constexpr TuningLayout()
+    {
+        for (int r = 0; r < N; ++r)
+        {
+            int refMidiNote = r + 60;
+            for (int note = 0; note < 128; ++note)
+            {
+                int diff = note - refMidiNote;
+                int oct = (diff >= 0) ? diff / N : -((N - 1 - diff) / N);
+                
+                double mul = 1.0;
+                for (int o = 0; o < oct; ++o)
+                    mul *= 2.0;
+                for (int o = 0; o > oct; --o)
+                    mul *= 0.5;
+                
+                degree[r][note] = static_cast<uint8_t>(diff - N * oct);
+                octave[r][note] = mul;
+            }
+        }
+    }
+    
+    uint8_t degree[N][128]{};
+    double octave[N][128]{};
+};
+
+// Only the sizes TuningTable::build asks for get built
+template <int N>
+inline constexpr TuningLayout<N> tuningLayout{};
+
+//==============================================================================
+// The 128 note frequency table from a reference and the scale's ratios. No JUCE
+// in here so the benchmarks can use it as it is.
+struct TuningTable
+{
+    static void build(int size, int refNote, double refFreq, const double *r, double *out)
+    {
+        switch (size)
+        {
+            case 7:
+                return buildFor<7>(refNote, refFreq, r, out);
+            case 12:
+                return buildFor<12>(refNote, refFreq, r, out);
+            case 19:
+                return buildFor<19>(refNote, refFreq, r, out);
+            case 22:
+                return buildFor<22>(refNote, refFreq, r, out);
+            case 31:
+                return buildFor<31>(refNote, refFreq, r, out);
+            case 53:
+                return buildFor<53>(refNote, refFreq, r, out);
+        }
+        
+        // Anything else works the layout out as it goes
+        for (int note = 0; note < 128; ++note)
+        {
+            int diff = note - (refNote + 60);
+            int oct = (diff >= 0) ? diff / size : -((size - 1 - diff) / size);
+            out[note] = std::ldexp(refFreq * r[diff - size * oct], oct);
+        }
+    }
+    
+    template <int N>
+    static void buildFor(int refNote, double refFreq, const double *r, double *out)
+    {
+        double base[N];
+        for (int d = 0; d < N; ++d)
+        {
+            base[d] = refFreq * r[d];
+        }
+        
+        // degree pass, then octave pass
+        const auto &degree = tuningLayout<N>.degree[refNote];
+        const auto &octave = tuningLayout<N>.octave[refNote];
+        for (int note = 0; note < 128; ++note)
+        {
+            out[note] = base[degree[note]];
+        }
+        for (int note = 0; note < 128; ++note)
+        {
+            out[note] *= octave[note];
+        }
+    }
+    
+    // When only the reference frequency moved
+    static void rescale(double *table, double by)
+    {
+        for (int note = 0; note < 128; ++note)
+        {
+            table[note] *= by;
+        }
+    }
+};